@@ -0,0 +1,66 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN 8
+
+struct ArenaBlock_ {
+  struct ArenaBlock_ *next;
+  // padding keeps the data that follows aligned
+  long long data[1];
+};
+
+typedef struct ArenaBlock_ ArenaBlock;
+
+void initArena(Arena *arena) {
+  arena->blocks = NULL;
+  arena->next = NULL;
+  arena->limit = NULL;
+  arena->allocCount = 0;
+  arena->blockCount = 0;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+  ArenaBlock *block;
+  size_t blockSize;
+  void *p;
+
+  size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+  arena->allocCount ++;
+
+  if ((size_t) (arena->limit - arena->next) < size) {
+    // Oversized requests get a block of their own
+    blockSize = (size > ARENA_BLOCK_SIZE / 4) ? size : ARENA_BLOCK_SIZE;
+    block = (ArenaBlock *) malloc(offsetof(ArenaBlock, data) + blockSize);
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->blockCount ++;
+
+    if (blockSize != ARENA_BLOCK_SIZE)
+      return block->data;
+    arena->next = (char *) block->data;
+    arena->limit = arena->next + blockSize;
+  }
+
+  p = arena->next;
+  arena->next += size;
+  return p;
+}
+
+void freeArena(Arena *arena) {
+  ArenaBlock *block = arena->blocks;
+  ArenaBlock *next;
+
+  while (block != NULL) {
+    next = block->next;
+    free(block);
+    block = next;
+  }
+  initArena(arena);
+}
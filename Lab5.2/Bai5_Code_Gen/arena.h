@@ -0,0 +1,31 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+// Region allocator for data that lives as long as one compilation:
+// objects are carved out of large blocks and released all at once.
+
+struct ArenaBlock_;
+
+struct Arena_ {
+  struct ArenaBlock_ *blocks;
+  char *next;
+  char *limit;
+  long allocCount;        // number of arenaAlloc calls
+  long blockCount;        // number of underlying malloc calls
+};
+
+typedef struct Arena_ Arena;
+
+void initArena(Arena *arena);
+void *arenaAlloc(Arena *arena, size_t size);
+void freeArena(Arena *arena);
+
+#endif
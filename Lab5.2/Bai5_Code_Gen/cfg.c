@@ -0,0 +1,347 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "cfg.h"
+
+/******************* Blocks ******************************/
+
+int endsBlock(enum OpCode op)
+{
+  return isJumpOpCode(op) || (op == OP_EP) || (op == OP_EF) || (op == OP_HL);
+}
+
+// Whether the next instruction may run after op, at once or once a call returns
+int fallsThrough(enum OpCode op)
+{
+  return (op != OP_J) && (op != OP_EP) && (op != OP_EF) && (op != OP_HL);
+}
+
+int blockAt(ControlFlowGraph *cfg, CodeAddress address)
+{
+  if ((address < 0) || (address >= cfg->codeBlock->codeSize))
+    return NO_BLOCK;
+  return cfg->blockOf[address];
+}
+
+// Pop count operands and push the result of the instruction at address.
+// stack holds where the code computing each operand starts, -1 when that
+// code lies before the block.
+void simulateOperands(int *stack, int *depth, int count, CodeAddress address)
+{
+  int start = address;
+
+  if (count > 0)
+    start = (*depth >= count) ? stack[*depth - count] : -1;
+  *depth = (*depth >= count) ? *depth - count : 0;
+  stack[(*depth)++] = start;
+}
+
+void linkFrameStores(ControlFlowGraph *cfg, int *stack)
+{
+  Instruction *code = cfg->codeBlock->code;
+  BasicBlock *block;
+  CodeAddress i, address;
+  int b, depth;
+
+  for (b = 0; b < cfg->blockCount; b++)
+  {
+    block = cfg->blocks + b;
+    depth = 0;
+    for (i = block->start; i < block->end; i++)
+    {
+      switch (code[i].op)
+      {
+      case OP_LA:
+      case OP_LV:
+      case OP_LC:
+      case OP_RC:
+      case OP_RI:
+        simulateOperands(stack, &depth, 0, i);
+        break;
+      case OP_LI:
+      case OP_NEG:
+        simulateOperands(stack, &depth, 1, i);
+        break;
+      case OP_AD:
+      case OP_SB:
+      case OP_ML:
+      case OP_DV:
+      case OP_EQ:
+      case OP_NE:
+      case OP_GT:
+      case OP_LT:
+      case OP_GE:
+      case OP_LE:
+        simulateOperands(stack, &depth, 2, i);
+        break;
+      case OP_ST:
+        // The address must be a lone LA 0,q right before the value's code
+        if (depth >= 2)
+        {
+          address = stack[depth - 2];
+          if ((address >= 0) && (code[address].op == OP_LA) && (code[address].p == 0) && (stack[depth - 1] == address + 1))
+          {
+            cfg->storeLink[address] = i;
+            cfg->storeLink[i] = address;
+          }
+        }
+        depth = (depth >= 2) ? depth - 2 : 0;
+        break;
+      case OP_WRI:
+      case OP_WRC:
+        depth = (depth >= 1) ? depth - 1 : 0;
+        break;
+      case OP_WLN:
+      case OP_INCV:
+        break;
+      default:
+        depth = 0;
+        break;
+      }
+    }
+  }
+}
+
+ControlFlowGraph *buildControlFlowGraph(CodeBlock *codeBlock)
+{
+  ControlFlowGraph *cfg = (ControlFlowGraph *)malloc(sizeof(ControlFlowGraph));
+  Instruction *code = codeBlock->code;
+  int codeSize = codeBlock->codeSize;
+  char *isLeader = (char *)calloc(codeSize + 1, sizeof(char));
+  int *stack;
+  BasicBlock *block;
+  Instruction *last;
+  int i, n;
+
+  isLeader[0] = 1;
+  for (i = 0; i < codeSize; i++)
+  {
+    if (isJumpOpCode(code[i].op) && (code[i].q >= 0) && (code[i].q < codeSize))
+      isLeader[code[i].q] = 1;
+    if (endsBlock(code[i].op))
+      isLeader[i + 1] = 1;
+  }
+
+  n = 0;
+  for (i = 0; i < codeSize; i++)
+    n += isLeader[i];
+
+  cfg->codeBlock = codeBlock;
+  cfg->blocks = (BasicBlock *)malloc((n + 1) * sizeof(BasicBlock));
+  cfg->blockCount = n;
+  cfg->blockOf = (int *)malloc((codeSize + 1) * sizeof(int));
+  cfg->storeLink = (int *)malloc((codeSize + 1) * sizeof(int));
+
+  n = -1;
+  for (i = 0; i < codeSize; i++)
+  {
+    if (isLeader[i])
+    {
+      n++;
+      cfg->blocks[n].start = i;
+      if (n > 0)
+        cfg->blocks[n - 1].end = i;
+    }
+    cfg->blockOf[i] = n;
+    cfg->storeLink[i] = -1;
+  }
+  if (n >= 0)
+    cfg->blocks[n].end = codeSize;
+  cfg->blockOf[codeSize] = NO_BLOCK;
+  cfg->storeLink[codeSize] = -1;
+
+  for (n = 0; n < cfg->blockCount; n++)
+  {
+    block = cfg->blocks + n;
+    last = code + block->end - 1;
+    block->next = fallsThrough(last->op) ? blockAt(cfg, block->end) : NO_BLOCK;
+    block->target = NO_BLOCK;
+    block->callee = NO_BLOCK;
+    if ((last->op == OP_CALL) || (last->op == OP_ENTER) || (last->op == OP_ENTERL))
+      block->callee = blockAt(cfg, last->q);
+    else if (isJumpOpCode(last->op))
+      block->target = blockAt(cfg, last->q);
+    block->reachable = 0;
+    block->liveIn = 0;
+    block->liveOut = 0;
+  }
+
+  stack = (int *)malloc((codeSize + 1) * sizeof(int));
+  linkFrameStores(cfg, stack);
+  free(stack);
+  free(isLeader);
+  return cfg;
+}
+
+void freeControlFlowGraph(ControlFlowGraph *cfg)
+{
+  free(cfg->blocks);
+  free(cfg->blockOf);
+  free(cfg->storeLink);
+  free(cfg);
+}
+
+/******************* Reachability ******************************/
+
+// Everything control can get to from the first instruction. A subprogram
+// is reached through the calls to it, so one never called stays unmarked.
+void markReachableBlocks(ControlFlowGraph *cfg)
+{
+  int *work = (int *)malloc((cfg->blockCount + 1) * sizeof(int));
+  int count = 0;
+  BasicBlock *block;
+  int b;
+
+  for (b = 0; b < cfg->blockCount; b++)
+    cfg->blocks[b].reachable = 0;
+  if (cfg->blockCount > 0)
+  {
+    cfg->blocks[0].reachable = 1;
+    work[count++] = 0;
+  }
+
+  while (count > 0)
+  {
+    block = cfg->blocks + work[--count];
+    if ((block->next != NO_BLOCK) && !cfg->blocks[block->next].reachable)
+    {
+      cfg->blocks[block->next].reachable = 1;
+      work[count++] = block->next;
+    }
+    if ((block->target != NO_BLOCK) && !cfg->blocks[block->target].reachable)
+    {
+      cfg->blocks[block->target].reachable = 1;
+      work[count++] = block->target;
+    }
+    if ((block->callee != NO_BLOCK) && !cfg->blocks[block->callee].reachable)
+    {
+      cfg->blocks[block->callee].reachable = 1;
+      work[count++] = block->callee;
+    }
+  }
+  free(work);
+}
+
+/******************* Live frame slots ******************************/
+
+SlotSet slotBit(int slot)
+{
+  return ((slot >= 0) && (slot < SLOT_SET_SIZE)) ? ((SlotSet)1 << slot) : 0;
+}
+
+// The slots of the current frame that may still be read before the
+// instruction at address, given those live after it. Each subprogram is
+// analysed on its own: a call may read any slot through the static link
+// or a VAR argument, and so may an address that is not simply stored to.
+SlotSet liveBefore(ControlFlowGraph *cfg, CodeAddress address, SlotSet live)
+{
+  Instruction *code = cfg->codeBlock->code;
+  Instruction *inst = code + address;
+  int link = cfg->storeLink[address];
+
+  switch (inst->op)
+  {
+  case OP_ST:
+    if (link >= 0)
+      live &= ~slotBit(code[link].q);
+    return live;
+  case OP_LA:
+    if ((inst->p == 0) && (link < 0))
+      return ALL_SLOTS;
+    return live;
+  case OP_LV:
+    if (inst->p == 0)
+      live |= slotBit(inst->q);
+    return live;
+  case OP_INCV:
+    return live | slotBit(inst->q);
+  case OP_CALL:
+  case OP_ENTER:
+  case OP_ENTERL:
+    return ALL_SLOTS;
+  case OP_DCT:
+    // Cells above the frame are stack cells, and one may stay on top for
+    // the code that follows to pop: an inlined function leaves its result so
+    return ALL_SLOTS;
+  case OP_EF:
+    // The caller reads the result from slot 0
+    return slotBit(0);
+  case OP_EP:
+  case OP_HL:
+    return 0;
+  default:
+    return live;
+  }
+}
+
+// Live slots flow back along jumps and fall-throughs, never into a callee
+void computeLiveSlots(ControlFlowGraph *cfg)
+{
+  BasicBlock *block;
+  SlotSet live;
+  CodeAddress i;
+  int b, changed;
+
+  for (b = 0; b < cfg->blockCount; b++)
+  {
+    cfg->blocks[b].liveIn = 0;
+    cfg->blocks[b].liveOut = 0;
+  }
+
+  do
+  {
+    changed = 0;
+    for (b = cfg->blockCount - 1; b >= 0; b--)
+    {
+      block = cfg->blocks + b;
+      live = 0;
+      if (block->next != NO_BLOCK)
+        live |= cfg->blocks[block->next].liveIn;
+      if (block->target != NO_BLOCK)
+        live |= cfg->blocks[block->target].liveIn;
+      block->liveOut = live;
+
+      for (i = block->end - 1; i >= block->start; i--)
+        live = liveBefore(cfg, i, live);
+      if (live != block->liveIn)
+      {
+        block->liveIn = live;
+        changed = 1;
+      }
+    }
+  } while (changed);
+}
+
+/******************* Linearization ******************************/
+
+// Drop the instructions marked removed and renumber the rest. A jump to a
+// removed instruction goes on to the next one that is kept. Returns the
+// number of instructions removed.
+int linearizeCode(CodeBlock *codeBlock, char *removed)
+{
+  Instruction *code = codeBlock->code;
+  int codeSize = codeBlock->codeSize;
+  int *newAddress = (int *)malloc((codeSize + 1) * sizeof(int));
+  int outSize = 0;
+  int i;
+
+  for (i = 0; i < codeSize; i++)
+  {
+    newAddress[i] = outSize;
+    if (!removed[i])
+      code[outSize++] = code[i];
+  }
+  newAddress[codeSize] = outSize;
+
+  for (i = 0; i < outSize; i++)
+    if (isJumpOpCode(code[i].op) && (code[i].q >= 0) && (code[i].q <= codeSize))
+      code[i].q = newAddress[code[i].q];
+
+  codeBlock->codeSize = outSize;
+  free(newAddress);
+  return codeSize - outSize;
+}
@@ -0,0 +1,60 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CFG_H__
+#define __CFG_H__
+
+#include "instructions.h"
+
+// Control flow graph over a finished code block. A basic block ends at a
+// jump, a call, EP, EF or HL, or just before a jump target.
+
+#define NO_BLOCK -1
+
+// Slots 0..SLOT_SET_SIZE-1 of the current frame are tracked one bit each
+// by the liveness analysis. Higher slots always count as live.
+#define SLOT_SET_SIZE 64
+#define ALL_SLOTS (~(SlotSet)0)
+
+typedef unsigned long long SlotSet;
+
+struct BasicBlock_ {
+  CodeAddress start;
+  CodeAddress end;          // one past the last instruction
+  int next;                 // block reached by falling through, or the return point of a call
+  int target;               // block a jump may go to
+  int callee;               // block a CALL, ENTER or ENTERL enters
+  int reachable;
+  SlotSet liveIn;
+  SlotSet liveOut;
+};
+
+typedef struct BasicBlock_ BasicBlock;
+
+struct ControlFlowGraph_ {
+  CodeBlock* codeBlock;
+  BasicBlock* blocks;
+  int blockCount;
+  int* blockOf;             // block holding each instruction
+  // Pairs the LA 0,q and the ST of a store to a slot of the current frame
+  // that lies within one block: each holds the other's address, else -1
+  int* storeLink;
+};
+
+typedef struct ControlFlowGraph_ ControlFlowGraph;
+
+ControlFlowGraph* buildControlFlowGraph(CodeBlock* codeBlock);
+void freeControlFlowGraph(ControlFlowGraph* cfg);
+
+void markReachableBlocks(ControlFlowGraph* cfg);
+
+SlotSet slotBit(int slot);
+SlotSet liveBefore(ControlFlowGraph* cfg, CodeAddress address, SlotSet live);
+void computeLiveSlots(ControlFlowGraph* cfg);
+
+int linearizeCode(CodeBlock* codeBlock, char* removed);
+
+#endif
@@ -5,10 +5,15 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "reader.h"
 #include "codegen.h"
+#include "optimizer.h"
+#include "inliner.h"
+#include "statlink.h"
 
-#define CODE_SIZE 10000
+#define INITIAL_CODE_SIZE 1024
 extern SymTab *symtab;
 
 extern Object *readiFunction;
@@ -19,36 +24,52 @@ extern Object *writelnProcedure;
 
 CodeBlock *codeBlock;
 
+int computeNestedLevel(Scope *scope)
+{
+  // Number of static links to follow from the current frame to a frame of scope
+  return symtab->currentScope->depth - scope->depth;
+}
+
 void genVariableAddress(Object *var)
 {
-  // Compute the level difference between current scope and variable's scope
-  Scope *currentScope = symtab->currentScope;
-  Scope *varScope = VARIABLE_SCOPE(var);
-  int level = 0;
+  genLA(computeNestedLevel(VARIABLE_SCOPE(var)), VARIABLE_OFFSET(var));
+}
 
-  while (currentScope != NULL && currentScope != varScope)
-  {
-    level++;
-    currentScope = currentScope->outer;
-  }
+void genVariableValue(Object *var)
+{
+  genLV(computeNestedLevel(VARIABLE_SCOPE(var)), VARIABLE_OFFSET(var));
+}
 
-  genLA(level, VARIABLE_OFFSET(var));
+void genParameterAddress(Object *param)
+{
+  // A reference parameter already holds the address of the argument
+  if (param->paramAttrs->kind == PARAM_REFERENCE)
+    genLV(computeNestedLevel(PARAMETER_SCOPE(param)), PARAMETER_OFFSET(param));
+  else
+    genLA(computeNestedLevel(PARAMETER_SCOPE(param)), PARAMETER_OFFSET(param));
 }
 
-void genVariableValue(Object *var)
+void genParameterValue(Object *param)
 {
-  // Compute the level difference between current scope and variable's scope
-  Scope *currentScope = symtab->currentScope;
-  Scope *varScope = VARIABLE_SCOPE(var);
-  int level = 0;
+  genLV(computeNestedLevel(PARAMETER_SCOPE(param)), PARAMETER_OFFSET(param));
+  if (param->paramAttrs->kind == PARAM_REFERENCE)
+    genLI();
+}
 
-  while (currentScope != NULL && currentScope != varScope)
-  {
-    level++;
-    currentScope = currentScope->outer;
-  }
+void genControlAddress(Object *controlVar)
+{
+  if (controlVar->kind == OBJ_VARIABLE)
+    genVariableAddress(controlVar);
+  else
+    genParameterAddress(controlVar);
+}
 
-  genLV(level, VARIABLE_OFFSET(var));
+void genControlValue(Object *controlVar)
+{
+  if (controlVar->kind == OBJ_VARIABLE)
+    genVariableValue(controlVar);
+  else
+    genParameterValue(controlVar);
 }
 
 int isPredefinedFunction(Object *func)
@@ -109,18 +130,29 @@ void genDCT(int delta)
   emitDCT(codeBlock, delta);
 }
 
-Instruction *genJ(CodeAddress label)
+CodeAddress genJ(CodeAddress label)
 {
-  Instruction *inst = codeBlock->code + codeBlock->codeSize;
+  CodeAddress addr = codeBlock->codeSize;
   emitJ(codeBlock, label);
-  return inst;
+  return addr;
 }
 
-Instruction *genFJ(CodeAddress label)
+CodeAddress genFJ(CodeAddress label)
 {
-  Instruction *inst = codeBlock->code + codeBlock->codeSize;
+  CodeAddress addr = codeBlock->codeSize;
+  enum OpCode op = (addr > 0) ? negateCompareJump(codeBlock->code[addr - 1].op) : OP_FJ;
+
+  // A condition is only ever a branch test, so the comparison it ends with
+  // and this jump become one compare-and-jump
+  if (op != OP_FJ)
+  {
+    addr--;
+    codeBlock->code[addr].op = op;
+    codeBlock->code[addr].q = label;
+    return addr;
+  }
   emitFJ(codeBlock, label);
-  return inst;
+  return addr;
 }
 
 void genHL(void)
@@ -138,6 +170,31 @@ void genCALL(int level, CodeAddress label)
   emitCALL(codeBlock, level, label);
 }
 
+void genENTER(int level, CodeAddress label)
+{
+  emitENTER(codeBlock, level, label);
+}
+
+// Jumps when the condition just compiled holds
+CodeAddress genTJ(CodeAddress label)
+{
+  CodeAddress addr = codeBlock->codeSize;
+  enum OpCode op = (addr > 0) ? compareJump(codeBlock->code[addr - 1].op) : OP_FJ;
+  CodeAddress fjLabel;
+
+  if (op != OP_FJ)
+  {
+    addr--;
+    codeBlock->code[addr].op = op;
+    codeBlock->code[addr].q = label;
+    return addr;
+  }
+  fjLabel = genFJ(DC_VALUE);
+  addr = genJ(label);
+  updateFJ(fjLabel, getCurrentCodeAddress());
+  return addr;
+}
+
 void genEP(void)
 {
   emitEP(codeBlock);
@@ -233,14 +290,624 @@ void genLE(void)
   emitLE(codeBlock);
 }
 
-void updateJ(Instruction *jmp, CodeAddress label)
+// Jumps are patched by address: the code block may have moved since they were emitted
+void updateJ(CodeAddress jmp, CodeAddress label)
+{
+  codeBlock->code[jmp].q = label;
+}
+
+// jmp is whatever genFJ returned, possibly a fused compare-and-jump
+void updateFJ(CodeAddress jmp, CodeAddress label)
+{
+  codeBlock->code[jmp].q = label;
+}
+
+void updateCALL(CodeAddress start, CodeAddress oldLabel, CodeAddress newLabel)
+{
+  Instruction *inst;
+  Instruction *end = codeBlock->code + codeBlock->codeSize;
+
+  for (inst = codeBlock->code + start; inst < end; inst++)
+    if (((inst->op == OP_CALL) || (inst->op == OP_ENTER)) && (inst->q == oldLabel))
+      inst->q = newLabel;
+}
+
+// The INT at the start of a block also tells ENTER how many arguments the caller pushed
+void updateFrame(CodeAddress inc, int paramCount, int frameSize)
+{
+  codeBlock->code[inc].p = paramCount;
+  codeBlock->code[inc].q = frameSize;
+}
+
+/******************* Constant folding ******************************/
+
+// Operands are folded as soon as they are compiled, so an operand whose
+// code ends with LC consists of that LC alone.
+
+int isConstantOperand(CodeAddress end)
+{
+  return (end > 0) && (codeBlock->code[end - 1].op == OP_LC);
+}
+
+int isConstantCode(CodeAddress start, WORD *value)
+{
+  if ((codeBlock->codeSize != start + 1) || (codeBlock->code[start].op != OP_LC))
+    return 0;
+  *value = codeBlock->code[start].q;
+  return 1;
+}
+
+void discardCode(CodeAddress start)
+{
+  codeBlock->codeSize = start;
+}
+
+// Splits a trailing "+ c" or "- c" off the expression compiled from start on
+int peelConstantTerm(CodeAddress start, WORD *value)
+{
+  Instruction *last = codeBlock->code + codeBlock->codeSize - 1;
+
+  if ((codeBlock->codeSize - start < 3) || (last[-1].op != OP_LC))
+    return 0;
+  if (last->op == OP_AD)
+    *value = last[-1].q;
+  else if (last->op == OP_SB)
+    *value = foldArithmetic(OP_NEG, last[-1].q, 0);
+  else
+    return 0;
+  codeBlock->codeSize -= 2;
+  return 1;
+}
+
+// Adds a constant displacement to the address computed from base on,
+// folding it into the LA that starts the computation when there is one
+void genAddressOffset(CodeAddress base, WORD offset)
+{
+  if (offset == 0)
+    return;
+  if (codeBlock->code[base].op == OP_LA)
+    codeBlock->code[base].q += offset;
+  else
+  {
+    genLC(offset);
+    genAD();
+  }
+}
+
+// Takes the code from start on out of the block, to be emitted again by pasteCode.
+// The code must not be the target of any jump.
+int cutCode(CodeAddress start, Instruction **fragment)
+{
+  int size = codeBlock->codeSize - start;
+
+  *fragment = (Instruction *)malloc(size * sizeof(Instruction));
+  memcpy(*fragment, codeBlock->code + start, size * sizeof(Instruction));
+  codeBlock->codeSize = start;
+  return size;
+}
+
+void pasteCode(Instruction *fragment, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++)
+    emitCode(codeBlock, fragment[i].op, fragment[i].p, fragment[i].q);
+  free(fragment);
+}
+
+int foldNegation(CodeAddress start)
 {
-  jmp->q = label;
+  Instruction *operand = codeBlock->code + start;
+
+  if ((codeBlock->codeSize != start + 1) || (operand->op != OP_LC))
+    return 0;
+  operand->q = foldArithmetic(OP_NEG, operand->q, 0);
+  return 1;
 }
 
-void updateFJ(Instruction *jmp, CodeAddress label)
+int foldBinaryOperation(enum OpCode op, CodeAddress rightStart)
 {
-  jmp->q = label;
+  Instruction *right = codeBlock->code + rightStart;
+  Instruction *left = right - 1;
+
+  if ((codeBlock->codeSize != rightStart + 1) || (right->op != OP_LC))
+    return 0;
+  // Division by zero is left for the VM to report
+  if ((op == OP_DV) && (right->q == 0))
+    return 0;
+
+  if (isConstantOperand(rightStart))
+  {
+    // LC a; LC b  =>  LC a op b
+    left->q = foldArithmetic(op, left->q, right->q);
+    codeBlock->codeSize--;
+    return 1;
+  }
+
+  // x + 0, x - 0, x * 1 and x / 1 need no code at all
+  if ((((op == OP_AD) || (op == OP_SB)) && (right->q == 0)) || (((op == OP_ML) || (op == OP_DV)) && (right->q == 1)))
+  {
+    codeBlock->codeSize--;
+    return 1;
+  }
+
+  // x + a + b  =>  x + (a + b), and likewise for - and *
+  if ((rightStart >= 2) && isConstantOperand(rightStart - 1))
+  {
+    if (((op == OP_AD) || (op == OP_SB)) && ((left->op == OP_AD) || (left->op == OP_SB)))
+    {
+      left[-1].q = foldArithmetic((left->op == op) ? OP_AD : OP_SB, left[-1].q, right->q);
+      codeBlock->codeSize--;
+      return 1;
+    }
+    if ((op == OP_ML) && (left->op == OP_ML))
+    {
+      left[-1].q = foldArithmetic(OP_ML, left[-1].q, right->q);
+      codeBlock->codeSize--;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/******************* Induction variables ******************************/
+
+// Under -O, element addresses indexed by a FOR control variable are kept
+// in hidden frame slots that step along with the variable, instead of being
+// recomputed with LV; LC; ML; AD on every access.
+
+InductionLoop *currentLoop = NULL;
+
+void beginInductionLoop(InductionLoop *loop, Object *var)
+{
+  loop->var = var;
+  loop->bodyStart = getCurrentCodeAddress();
+  loop->invalid = 0;
+  loop->sites = NULL;
+  loop->siteCount = 0;
+  loop->maxSites = 0;
+  loop->steps = NULL;
+  loop->stepCount = 0;
+  loop->outer = currentLoop;
+  currentLoop = loop;
+}
+
+// base is the LA of an element address that has just been compiled. It is a
+// site when the first index is exactly the control variable of an open loop,
+// possibly times a constant: LA p,q; LV var; [LC k; ML]; AD
+void recordInductionSite(CodeAddress base)
+{
+  Instruction *code = codeBlock->code + base;
+  InductionLoop *loop;
+  InductionSite *site;
+  int length;
+
+  if ((currentLoop == NULL) || (codeBlock->codeSize - base < 3) || (code[0].op != OP_LA) || (code[1].op != OP_LV))
+    return;
+  if (code[2].op == OP_AD)
+    length = 3;
+  else if ((codeBlock->codeSize - base >= 5) && (code[2].op == OP_LC) && (code[3].op == OP_ML) && (code[4].op == OP_AD))
+    length = 5;
+  else
+    return;
+
+  for (loop = currentLoop; loop != NULL; loop = loop->outer)
+    if ((code[1].p == computeNestedLevel(VARIABLE_SCOPE(loop->var))) && (code[1].q == VARIABLE_OFFSET(loop->var)))
+      break;
+  if ((loop == NULL) || loop->invalid)
+    return;
+
+  if (loop->siteCount == loop->maxSites)
+  {
+    loop->maxSites = (loop->maxSites == 0) ? 8 : loop->maxSites * 2;
+    loop->sites = (InductionSite *)realloc(loop->sites, loop->maxSites * sizeof(InductionSite));
+  }
+  site = loop->sites + loop->siteCount++;
+  site->base = base;
+  site->length = length;
+  site->step = (length == 5) ? code[2].q : 1;
+  site->slot = -1;
+}
+
+// Called when var may be assigned; NULL stands for any variable, e.g. across a
+// call or a store through a reference parameter
+void invalidateInductionLoops(Object *var)
+{
+  InductionLoop *loop;
+
+  for (loop = currentLoop; loop != NULL; loop = loop->outer)
+    if ((var == NULL) || (var == loop->var))
+      loop->invalid = 1;
+}
+
+// The code from start on is about to move, so its sites are given up
+void dropInductionSites(CodeAddress start)
+{
+  InductionLoop *loop;
+
+  for (loop = currentLoop; loop != NULL; loop = loop->outer)
+    while ((loop->siteCount > 0) && (loop->sites[loop->siteCount - 1].base >= start))
+      loop->siteCount--;
+}
+
+// Two sites share a running address when their code up to the index is the same
+int isSameAddress(Instruction *code, InductionSite *a, InductionSite *b)
+{
+  int i;
+
+  if (a->length != b->length)
+    return 0;
+  for (i = 0; i < a->length; i++)
+    if ((code[a->base + i].op != code[b->base + i].op) || (code[a->base + i].p != code[b->base + i].p) || (code[a->base + i].q != code[b->base + i].q))
+      return 0;
+  return 1;
+}
+
+// Closes the loop whose body has just been compiled. Every site gets a
+// running address slot, initialized in front of the body, and becomes a
+// single LV. Returns where the body now starts.
+CodeAddress endInductionLoop(InductionLoop *loop)
+{
+  Instruction *body;
+  InductionSite *site;
+  InductionLoop *outer;
+  int *newAddress;
+  int bodySize;
+  CodeAddress newStart;
+  int i, j;
+
+  currentLoop = loop->outer;
+  if (loop->invalid || (loop->siteCount == 0))
+  {
+    free(loop->sites);
+    loop->sites = NULL;
+    return loop->bodyStart;
+  }
+
+  // Sites are recorded in code order and never overlap
+  loop->steps = (InductionSite *)malloc(loop->siteCount * sizeof(InductionSite));
+  for (i = 0; i < loop->siteCount; i++)
+  {
+    site = loop->sites + i;
+    for (j = 0; j < loop->stepCount; j++)
+      if (isSameAddress(codeBlock->code, site, loop->steps + j))
+        break;
+    if (j == loop->stepCount)
+    {
+      loop->steps[j] = *site;
+      loop->steps[j].slot = symtab->currentScope->frameSize++;
+      loop->stepCount++;
+    }
+    site->slot = loop->steps[j].slot;
+  }
+
+  bodySize = codeBlock->codeSize - loop->bodyStart;
+  body = (Instruction *)malloc(bodySize * sizeof(Instruction));
+  memcpy(body, codeBlock->code + loop->bodyStart, bodySize * sizeof(Instruction));
+  newAddress = (int *)malloc((bodySize + 1) * sizeof(int));
+  codeBlock->codeSize = loop->bodyStart;
+
+  // slot := the address for the initial value of the control variable
+  for (j = 0; j < loop->stepCount; j++)
+  {
+    site = loop->steps + j;
+    genLA(0, site->slot);
+    for (i = 0; i < site->length; i++)
+      emitCode(codeBlock, body[site->base - loop->bodyStart + i].op, body[site->base - loop->bodyStart + i].p, body[site->base - loop->bodyStart + i].q);
+    genST();
+  }
+
+  newStart = getCurrentCodeAddress();
+  for (i = 0, j = 0; i < bodySize; i++)
+  {
+    newAddress[i] = getCurrentCodeAddress();
+    if ((j < loop->siteCount) && (loop->sites[j].base == loop->bodyStart + i))
+    {
+      genLV(0, loop->sites[j].slot);
+      while (--loop->sites[j].length > 0)
+        newAddress[++i] = getCurrentCodeAddress();
+      j++;
+    }
+    else
+      emitCode(codeBlock, body[i].op, body[i].p, body[i].q);
+  }
+  newAddress[bodySize] = getCurrentCodeAddress();
+
+  // Jumps within the body, and the sites enclosing loops recorded in it, moved
+  for (i = newStart; i < codeBlock->codeSize; i++)
+    if (isJumpOpCode(codeBlock->code[i].op) && (codeBlock->code[i].q >= loop->bodyStart) && (codeBlock->code[i].q <= loop->bodyStart + bodySize))
+      codeBlock->code[i].q = newAddress[codeBlock->code[i].q - loop->bodyStart];
+  for (outer = loop->outer; outer != NULL; outer = outer->outer)
+    for (i = 0; i < outer->siteCount; i++)
+      if (outer->sites[i].base >= loop->bodyStart)
+        outer->sites[i].base = newAddress[outer->sites[i].base - loop->bodyStart];
+
+  free(body);
+  free(newAddress);
+  free(loop->sites);
+  loop->sites = NULL;
+  return newStart;
+}
+
+// Steps every running address along with the control variable
+void genInductionSteps(InductionLoop *loop)
+{
+  int j;
+
+  for (j = 0; j < loop->stepCount; j++)
+  {
+    genLA(0, loop->steps[j].slot);
+    genLV(0, loop->steps[j].slot);
+    genLC(loop->steps[j].step);
+    genAD();
+    genST();
+  }
+  free(loop->steps);
+  loop->steps = NULL;
+}
+
+/******************* Tail calls ******************************/
+
+// Under -O, a subprogram calling itself as the last thing it does reuses
+// its frame: the arguments overwrite the parameters and a jump goes back to
+// the start of the body, so the recursion runs in constant stack.
+
+SelfCall *selfCalls = NULL;
+int selfCallCount = 0;
+int maxSelfCalls = 0;
+
+// Replace count instructions from start with the fragment. Jumps into the
+// replaced code go to its replacement, jumps past it follow the code.
+void replaceCode(CodeAddress start, int count, Instruction *fragment, int size)
+{
+  Instruction *tail;
+  int tailSize;
+  Instruction *inst;
+  int i;
+
+  tailSize = cutCode(start + count, &tail);
+  codeBlock->codeSize = start;
+  for (i = 0; i < size; i++)
+    emitCode(codeBlock, fragment[i].op, fragment[i].p, fragment[i].q);
+  pasteCode(tail, tailSize);
+
+  for (i = 0; i < codeBlock->codeSize; i++)
+  {
+    inst = codeBlock->code + i;
+    if ((i >= start) && (i < start + size))
+      continue;
+    if (!isJumpOpCode(inst->op))
+      continue;
+    if (inst->q >= start + count)
+      inst->q += size - count;
+    else if (inst->q > start)
+      inst->q = start;
+  }
+}
+
+int markSelfCalls(void)
+{
+  return selfCallCount;
+}
+
+// Loops move their code around, and nothing in a loop body is a tail call
+// anyway, so the calls recorded since mark are forgotten
+void dropSelfCalls(int mark)
+{
+  selfCallCount = mark;
+}
+
+void recordSelfCall(CodeAddress reserve, CodeAddress call)
+{
+  if (selfCallCount == maxSelfCalls)
+  {
+    maxSelfCalls = (maxSelfCalls == 0) ? 8 : 2 * maxSelfCalls;
+    selfCalls = (SelfCall *)realloc(selfCalls, maxSelfCalls * sizeof(SelfCall));
+  }
+  selfCalls[selfCallCount].reserve = reserve;
+  selfCalls[selfCallCount].call = call;
+  selfCallCount++;
+}
+
+// Whether only jumps lie between address and the end of the body
+int reachesExit(CodeAddress address)
+{
+  int steps = 0;
+
+  while ((address < codeBlock->codeSize) && (codeBlock->code[address].op == OP_J) && (steps++ < codeBlock->codeSize))
+    address = codeBlock->code[address].q;
+  return address == codeBlock->codeSize;
+}
+
+// Find where each of the count arguments pushed by the code in [start, end)
+// begins. Arguments are expressions, possibly with function calls in them.
+int splitArguments(CodeAddress start, CodeAddress end, int count, CodeAddress *starts)
+{
+  Instruction *code = codeBlock->code;
+  CodeAddress *stack = (CodeAddress *)malloc(((end - start) * RESERVED_WORDS + 1) * sizeof(CodeAddress));
+  int depth = 0;
+  int pops;
+  CodeAddress i, first;
+
+  for (i = start; i < end; i++)
+  {
+    switch (code[i].op)
+    {
+    case OP_LA:
+    case OP_LV:
+    case OP_LC:
+    case OP_RC:
+    case OP_RI:
+      pops = 0;
+      break;
+    case OP_LI:
+    case OP_NEG:
+      pops = 1;
+      break;
+    case OP_AD:
+    case OP_SB:
+    case OP_ML:
+    case OP_DV:
+    case OP_EQ:
+    case OP_NE:
+    case OP_GT:
+    case OP_LT:
+    case OP_GE:
+    case OP_LE:
+      pops = 2;
+      break;
+    case OP_INT:
+      // The header of a nested call, popped again by its ENTER
+      for (pops = 0; pops < code[i].q; pops++)
+        stack[depth++] = i;
+      continue;
+    case OP_ENTER:
+      pops = RESERVED_WORDS + code[code[i].q].p;
+      break;
+    default:
+      free(stack);
+      return 0;
+    }
+    if (depth < pops)
+      break;
+    first = (pops > 0) ? stack[depth - pops] : i;
+    depth -= pops;
+    stack[depth++] = first;
+  }
+
+  if ((i < end) || (depth != count))
+  {
+    free(stack);
+    return 0;
+  }
+  memcpy(starts, stack, count * sizeof(CodeAddress));
+  starts[count] = end;
+  free(stack);
+  return 1;
+}
+
+// Whether the code in [start, end) may read the given slot of the current
+// frame, directly or through a call
+int mayReadSlot(CodeAddress start, CodeAddress end, int slot)
+{
+  Instruction *code = codeBlock->code;
+  CodeAddress i;
+
+  for (i = start; i < end; i++)
+  {
+    if (((code[i].op == OP_LA) || (code[i].op == OP_LV)) && (code[i].p == 0) && (code[i].q == slot))
+      return 1;
+    if (code[i].op == OP_ENTER)
+      return 1;
+  }
+  return 0;
+}
+
+// Whether the code in [start, end) takes the address of a parameter or
+// local of the current frame: a VAR argument of a tail call must not, as
+// the jump reuses that frame and the cell would be the callee's own
+int takesFrameAddress(CodeAddress start, CodeAddress end)
+{
+  Instruction *code = codeBlock->code;
+  CodeAddress i;
+
+  for (i = start; i < end; i++)
+    if ((code[i].op == OP_LA) && (code[i].p == 0) && (code[i].q >= RESERVED_WORDS))
+      return 1;
+  return 0;
+}
+
+void appendInstruction(Instruction *fragment, int *size, enum OpCode op, WORD p, WORD q)
+{
+  fragment[*size].op = op;
+  fragment[*size].p = p;
+  fragment[*size].q = q;
+  (*size)++;
+}
+
+// Called once the body of the block starting at frame is compiled, before
+// its EP or EF. A procedure's CALL P(...) is a tail call when only jumps
+// follow it; a function's F := F(...) is when only jumps follow the ST.
+//
+// An argument goes straight into its parameter when no later argument reads
+// that parameter, and is left out when it is the parameter itself. The
+// others are pushed as before and copied down once all are evaluated.
+int eliminateTailCalls(int mark, CodeAddress frame, int paramCount, int isFunction)
+{
+  Instruction *code;
+  Instruction *fragment;
+  CodeAddress *starts = (CodeAddress *)malloc((paramCount + 1) * sizeof(CodeAddress));
+  int *pushed = (int *)malloc((paramCount + 1) * sizeof(int));
+  int frameSize = codeBlock->code[frame].q;
+  CodeAddress first, last, limit;
+  SelfCall *selfCall;
+  int count = 0;
+  int i, j, k, size, pushCount;
+
+  // From the last call back, so the addresses still to visit stay put. A
+  // call inside the arguments of one already replaced has moved: skip it.
+  limit = codeBlock->codeSize;
+  for (i = selfCallCount - 1; i >= mark; i--)
+  {
+    selfCall = selfCalls + i;
+    code = codeBlock->code;
+    if ((selfCall->call >= limit) || (code[selfCall->reserve].op != OP_INT) ||
+        (code[selfCall->call].op != OP_ENTER) || (code[selfCall->call].q != frame))
+      continue;
+    first = selfCall->reserve;
+    last = selfCall->call;
+    if (isFunction)
+    {
+      // The address of the result goes too
+      first--;
+      last++;
+      if ((code[first].op != OP_LA) || (code[first].p != 0) || (code[first].q != RETURN_VALUE_OFFSET) ||
+          (code[last].op != OP_ST))
+        continue;
+    }
+    if (!reachesExit(last + 1) || takesFrameAddress(selfCall->reserve + 1, selfCall->call) ||
+        !splitArguments(selfCall->reserve + 1, selfCall->call, paramCount, starts))
+      continue;
+
+    fragment = (Instruction *)malloc((last - first + 3 * paramCount + 2) * sizeof(Instruction));
+    size = 0;
+    pushCount = 0;
+    for (k = 0; k < paramCount; k++)
+    {
+      pushed[k] = -1;
+      if ((starts[k + 1] == starts[k] + 1) && (code[starts[k]].op == OP_LV) && (code[starts[k]].p == 0) &&
+          (code[starts[k]].q == RESERVED_WORDS + k))
+        continue;
+      if (!mayReadSlot(starts[k + 1], selfCall->call, RESERVED_WORDS + k))
+        appendInstruction(fragment, &size, OP_LA, 0, RESERVED_WORDS + k);
+      else
+        pushed[k] = pushCount++;
+      for (j = starts[k]; j < starts[k + 1]; j++)
+        fragment[size++] = code[j];
+      if (pushed[k] < 0)
+        appendInstruction(fragment, &size, OP_ST, 0, 0);
+    }
+    for (k = 0; k < paramCount; k++)
+      if (pushed[k] >= 0)
+      {
+        appendInstruction(fragment, &size, OP_LA, 0, RESERVED_WORDS + k);
+        appendInstruction(fragment, &size, OP_LV, 0, frameSize + pushed[k]);
+        appendInstruction(fragment, &size, OP_ST, 0, 0);
+      }
+    if (pushCount > 0)
+      appendInstruction(fragment, &size, OP_DCT, 0, pushCount);
+    appendInstruction(fragment, &size, OP_J, 0, frame + 1);
+
+    replaceCode(first, last - first + 1, fragment, size);
+    free(fragment);
+    limit = first;
+    count++;
+  }
+
+  free(starts);
+  free(pushed);
+  dropSelfCalls(mark);
+  return count;
 }
 
 CodeAddress getCurrentCodeAddress(void)
@@ -250,7 +917,7 @@ CodeAddress getCurrentCodeAddress(void)
 
 void initCodeBuffer(void)
 {
-  codeBlock = createCodeBlock(CODE_SIZE);
+  codeBlock = createCodeBlock(INITIAL_CODE_SIZE);
 }
 
 void printCodeBuffer(void)
@@ -258,6 +925,21 @@ void printCodeBuffer(void)
   printCodeBlock(codeBlock);
 }
 
+int inlineCodeBuffer(Object *program, int budget)
+{
+  return inlineSubprograms(codeBlock, program, budget);
+}
+
+int elideCodeBufferLinks(Object *program)
+{
+  return elideStaticLinks(codeBlock, program);
+}
+
+int optimizeCodeBuffer(void)
+{
+  return optimizeCodeBlock(codeBlock);
+}
+
 void cleanCodeBuffer(void)
 {
   freeCodeBlock(codeBlock);
@@ -34,8 +34,46 @@
 #define RETURN_ADDRESS_OFFSET 2
 #define STATIC_LINK_OFFSET 3
 
+// An element address base + i * step whose index i is the control
+// variable of an enclosing FOR loop
+struct InductionSite_ {
+  CodeAddress base;     // the LA starting the address
+  int length;           // up to and including the AD of the index
+  WORD step;
+  int slot;             // frame slot keeping the running address, or -1
+};
+
+typedef struct InductionSite_ InductionSite;
+
+struct InductionLoop_ {
+  Object* var;
+  CodeAddress bodyStart;
+  int invalid;          // the body may change var behind the loop's back
+  InductionSite* sites;
+  int siteCount;
+  int maxSites;
+  InductionSite* steps; // one site per running address, in slot order
+  int stepCount;
+  struct InductionLoop_* outer;
+};
+
+typedef struct InductionLoop_ InductionLoop;
+
+// A call of the subprogram being compiled to itself, from a statement
+struct SelfCall_ {
+  CodeAddress reserve;  // the INT reserving the frame header
+  CodeAddress call;     // the ENTER
+};
+
+typedef struct SelfCall_ SelfCall;
+
+int computeNestedLevel(Scope* scope);
 void genVariableAddress(Object* var);
 void genVariableValue(Object* var);
+void genParameterAddress(Object* param);
+void genParameterValue(Object* param);
+void genControlAddress(Object* controlVar);
+void genControlValue(Object* controlVar);
 
 void genPredefinedProcedureCall(Object* proc);
 void genPredefinedFunctionCall(Object* func);
@@ -46,11 +84,13 @@ void genLC(WORD constant);
 void genLI(void);
 void genINT(int delta);
 void genDCT(int delta);
-Instruction* genJ(CodeAddress label);
-Instruction* genFJ(CodeAddress label);
+CodeAddress genJ(CodeAddress label);
+CodeAddress genFJ(CodeAddress label);
 void genHL(void);
 void genST(void);
 void genCALL(int level, CodeAddress label);
+void genENTER(int level, CodeAddress label);
+CodeAddress genTJ(CodeAddress label);
 void genEP(void);
 void genEF(void);
 void genRC(void);
@@ -71,8 +111,32 @@ void genGE(void);
 void genLT(void);
 void genLE(void);
 
-void updateJ(Instruction* jmp, CodeAddress label);
-void updateFJ(Instruction* jmp, CodeAddress label);
+void updateCALL(CodeAddress start, CodeAddress oldLabel, CodeAddress newLabel);
+void updateFrame(CodeAddress inc, int paramCount, int frameSize);
+void updateJ(CodeAddress jmp, CodeAddress label);
+void updateFJ(CodeAddress jmp, CodeAddress label);
+
+int isConstantCode(CodeAddress start, WORD* value);
+void discardCode(CodeAddress start);
+int peelConstantTerm(CodeAddress start, WORD* value);
+void genAddressOffset(CodeAddress base, WORD offset);
+int cutCode(CodeAddress start, Instruction** fragment);
+void pasteCode(Instruction* fragment, int size);
+int foldNegation(CodeAddress start);
+int foldBinaryOperation(enum OpCode op, CodeAddress rightStart);
+
+void beginInductionLoop(InductionLoop* loop, Object* var);
+void recordInductionSite(CodeAddress base);
+void invalidateInductionLoops(Object* var);
+void dropInductionSites(CodeAddress start);
+CodeAddress endInductionLoop(InductionLoop* loop);
+void genInductionSteps(InductionLoop* loop);
+
+void replaceCode(CodeAddress start, int count, Instruction* fragment, int size);
+int markSelfCalls(void);
+void dropSelfCalls(int mark);
+void recordSelfCall(CodeAddress reserve, CodeAddress call);
+int eliminateTailCalls(int mark, CodeAddress frame, int paramCount, int isFunction);
 
 CodeAddress getCurrentCodeAddress(void);
 int isPredefinedProcedure(Object* proc);
@@ -80,6 +144,9 @@ int isPredefinedFunction(Object* func);
 
 void initCodeBuffer(void);
 void printCodeBuffer(void);
+int inlineCodeBuffer(Object* program, int budget);
+int elideCodeBufferLinks(Object* program);
+int optimizeCodeBuffer(void);
 void cleanCodeBuffer(void);
 
 int serialize(char* fileName);
@@ -0,0 +1,457 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "inliner.h"
+#include "codegen.h"
+#include "subprogram.h"
+
+#define MAX_INLINE_ROUNDS 3
+
+// A call to be replaced: the INT reserving the callee's frame header, the
+// ENTER, and the stack depth where the callee's frame will start
+struct CallSite_ {
+  CodeAddress reserve;
+  CodeAddress call;
+  int caller;
+  int callee;
+  int depth;
+};
+
+typedef struct CallSite_ CallSite;
+
+struct InlineContext_ {
+  CodeBlock *codeBlock;
+  SubprogramTable *table;
+  char *inlinable;          // for each subprogram of the table
+  CallSite *sites;
+  int siteCount;
+  int maxSites;
+};
+
+typedef struct InlineContext_ InlineContext;
+
+/******************* Subprograms ******************************/
+
+void setCodeAddress(Object *owner, CodeAddress address)
+{
+  if (owner->kind == OBJ_FUNCTION)
+    owner->funcAttrs->codeAddress = address;
+  else if (owner->kind == OBJ_PROCEDURE)
+    owner->procAttrs->codeAddress = address;
+}
+
+/******************* Call graph ******************************/
+
+// Whether sub can be reached again from the calls in its own body
+int isRecursive(InlineContext *ctx, int sub)
+{
+  Instruction *code = ctx->codeBlock->code;
+  char *visited = (char *)calloc(ctx->table->count, sizeof(char));
+  int *work = (int *)malloc(ctx->table->count * sizeof(int));
+  int count = 0;
+  int found = 0;
+  int caller, callee;
+  CodeAddress i;
+
+  work[count++] = sub;
+  while ((count > 0) && !found)
+  {
+    caller = work[--count];
+    for (i = ctx->table->subprograms[caller].entry + 1; i < ctx->table->subprograms[caller].exit; i++)
+    {
+      callee = calleeAt(ctx->table, code + i);
+      if (callee < 0)
+        continue;
+      if (callee == sub)
+        found = 1;
+      else if (!visited[callee])
+      {
+        visited[callee] = 1;
+        work[count++] = callee;
+      }
+    }
+  }
+
+  free(visited);
+  free(work);
+  return found;
+}
+
+// A callee is copied whole into its callers, so its body must be small, must
+// not come back to itself, and must not call its own nested subprograms:
+// those expect a static link to a frame of the callee.
+void markInlinable(InlineContext *ctx, int budget)
+{
+  Instruction *code = ctx->codeBlock->code;
+  Subprogram *sub;
+  CodeAddress i;
+  int k;
+
+  for (k = 1; k < ctx->table->count; k++)
+  {
+    sub = ctx->table->subprograms + k;
+    ctx->inlinable[k] = 0;
+    if (sub->exit - sub->entry - 1 > budget)
+      continue;
+    for (i = sub->entry + 1; i < sub->exit; i++)
+      if ((code[i].op == OP_CALL) || ((code[i].op == OP_ENTER) && (code[i].p == 0)))
+        break;
+    if (i < sub->exit)
+      continue;
+    ctx->inlinable[k] = !isRecursive(ctx, k);
+  }
+}
+
+/******************* Stack depths ******************************/
+
+int stackEffect(InlineContext *ctx, Instruction *inst)
+{
+  int callee;
+
+  switch (inst->op)
+  {
+  case OP_LA:
+  case OP_LV:
+  case OP_LC:
+  case OP_RC:
+  case OP_RI:
+  case OP_CV:
+    return 1;
+  case OP_INT:
+    return inst->q;
+  case OP_DCT:
+    return -inst->q;
+  case OP_FJ:
+  case OP_WRC:
+  case OP_WRI:
+  case OP_AD:
+  case OP_SB:
+  case OP_ML:
+  case OP_DV:
+  case OP_EQ:
+  case OP_NE:
+  case OP_GT:
+  case OP_LT:
+  case OP_GE:
+  case OP_LE:
+    return -1;
+  case OP_ST:
+  case OP_JEQ:
+  case OP_JNE:
+  case OP_JGT:
+  case OP_JLT:
+  case OP_JGE:
+  case OP_JLE:
+    return -2;
+  case OP_ENTER:
+    // The header and the arguments go; a function leaves its result
+    callee = calleeAt(ctx->table, inst);
+    return ((callee >= 0) ? ctx->table->subprograms[callee].isFunction : 0) - RESERVED_WORDS - ctx->codeBlock->code[inst->q].p;
+  default:
+    return 0;
+  }
+}
+
+void setDepth(Subprogram *sub, int *depth, int *work, int *count, CodeAddress address, int d)
+{
+  if ((address > sub->entry) && (address <= sub->exit) && (depth[address] < 0))
+  {
+    depth[address] = d;
+    work[(*count)++] = address;
+  }
+}
+
+// How many cells above the frame base are in use before each instruction of
+// sub's body. The code of a statement leaves the stack as it found it, so
+// every path gives an instruction the same depth.
+void computeStackDepths(InlineContext *ctx, Subprogram *sub, int *depth)
+{
+  Instruction *code = ctx->codeBlock->code;
+  int *work = (int *)malloc((sub->exit - sub->entry + 1) * sizeof(int));
+  int count = 0;
+  CodeAddress i;
+  enum OpCode op;
+  int d;
+
+  setDepth(sub, depth, work, &count, sub->entry + 1, sub->frameSize);
+  while (count > 0)
+  {
+    i = work[--count];
+    op = code[i].op;
+    d = depth[i] + stackEffect(ctx, code + i);
+    if ((op == OP_J) || (op == OP_FJ) || ((op >= OP_JEQ) && (op <= OP_JLE)))
+      setDepth(sub, depth, work, &count, code[i].q, d);
+    if ((op != OP_J) && (op != OP_EP) && (op != OP_EF) && (op != OP_HL))
+      setDepth(sub, depth, work, &count, i + 1, d);
+  }
+  free(work);
+}
+
+/******************* Call sites ******************************/
+
+void addCallSite(InlineContext *ctx, CodeAddress reserve, CodeAddress call, int caller, int callee, int depth)
+{
+  CallSite *site;
+
+  if (ctx->siteCount == ctx->maxSites)
+  {
+    ctx->maxSites *= 2;
+    ctx->sites = (CallSite *)realloc(ctx->sites, ctx->maxSites * sizeof(CallSite));
+  }
+  site = ctx->sites + ctx->siteCount++;
+  site->reserve = reserve;
+  site->call = call;
+  site->caller = caller;
+  site->callee = callee;
+  site->depth = depth;
+}
+
+// A call is INT 4; arguments; ENTER. The INT is the nearest one before the
+// ENTER at the depth the arguments start from: an INT of a call nested in
+// the arguments lies deeper.
+void findCallSites(InlineContext *ctx, int caller, int *depth)
+{
+  Instruction *code = ctx->codeBlock->code;
+  Subprogram *sub = ctx->table->subprograms + caller;
+  CodeAddress i, k, reserve;
+  int callee, d;
+
+  for (i = sub->entry + 1; i < sub->exit; i++)
+  {
+    callee = calleeAt(ctx->table, code + i);
+    if ((callee < 0) || (callee == caller) || !ctx->inlinable[callee] || (depth[i] < 0))
+      continue;
+
+    d = depth[i] - RESERVED_WORDS - ctx->table->subprograms[callee].paramCount;
+    for (reserve = i - 1; reserve > sub->entry; reserve--)
+      if ((code[reserve].op == OP_INT) && (code[reserve].q == RESERVED_WORDS) && (depth[reserve] == d))
+        break;
+    if (reserve <= sub->entry)
+      continue;
+    // Code inlined in the arguments by an earlier round addresses cells
+    // above the header, which are about to move
+    for (k = reserve + 1; k < i; k++)
+      if (((code[k].op == OP_LA) || (code[k].op == OP_LV) || (code[k].op == OP_INCV)) &&
+          ((code[k].op == OP_INCV) || (code[k].p == 0)) && (code[k].q >= d))
+        break;
+    if (k == i)
+      addCallSite(ctx, reserve, i, caller, callee, d);
+  }
+}
+
+/******************* Splicing ******************************/
+
+// The callee's frame stays where the call would have put it, right above
+// the caller's stack at the call, but without the links: a function keeps
+// its result cell, then come the arguments as they were pushed, then the
+// locals. Callee slot q becomes caller slot depth + mapSlot(q).
+int mapSlot(Subprogram *callee, int slot)
+{
+  if (slot == RETURN_VALUE_OFFSET)
+    return 0;
+  return callee->isFunction + slot - RESERVED_WORDS;
+}
+
+int spliceBody(InlineContext *ctx, CallSite *site, int depth, Instruction *out, char *remap, int outSize)
+{
+  Instruction *code = ctx->codeBlock->code;
+  Subprogram *callee = ctx->table->subprograms + site->callee;
+  int levelShift = callee->depth - ctx->table->subprograms[site->caller].depth;
+  int locals = callee->frameSize - RESERVED_WORDS - callee->paramCount;
+  CodeAddress bodyStart, i;
+  Instruction *inst;
+
+  if (locals > 0)
+  {
+    out[outSize].op = OP_INT;
+    out[outSize].p = 0;
+    out[outSize].q = locals;
+    remap[outSize++] = 0;
+  }
+
+  bodyStart = outSize;
+  for (i = callee->entry + 1; i < callee->exit; i++)
+  {
+    inst = out + outSize;
+    *inst = code[i];
+    remap[outSize++] = 0;
+    switch (inst->op)
+    {
+    case OP_LA:
+    case OP_LV:
+      if (inst->p == 0)
+        inst->q = depth + mapSlot(callee, inst->q);
+      else
+        inst->p -= levelShift;
+      break;
+    case OP_INCV:
+      inst->q = depth + mapSlot(callee, inst->q);
+      break;
+    case OP_ENTER:
+      inst->p -= levelShift;
+      remap[outSize - 1] = 1;
+      break;
+    case OP_J:
+    case OP_FJ:
+    case OP_JEQ:
+    case OP_JNE:
+    case OP_JGT:
+    case OP_JLT:
+    case OP_JGE:
+    case OP_JLE:
+      // The exit maps to the DCT below
+      inst->q = bodyStart + inst->q - (callee->entry + 1);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Drop the frame, leaving a function's result on top
+  if (callee->paramCount + locals > 0)
+  {
+    out[outSize].op = OP_DCT;
+    out[outSize].p = 0;
+    out[outSize].q = callee->paramCount + locals;
+    remap[outSize++] = 0;
+  }
+  return outSize;
+}
+
+int inlineCallSites(InlineContext *ctx)
+{
+  CodeBlock *codeBlock = ctx->codeBlock;
+  Instruction *code = codeBlock->code;
+  int codeSize = codeBlock->codeSize;
+  int *siteAt = (int *)malloc((codeSize + 1) * sizeof(int));
+  int *shift = (int *)calloc(codeSize + 1, sizeof(int));
+  int *newAddress = (int *)malloc((codeSize + 1) * sizeof(int));
+  Instruction *out;
+  char *remap;
+  CallSite *site;
+  int maxSize, outSize, k, s, saved;
+  CodeAddress i;
+
+  for (i = 0; i <= codeSize; i++)
+    siteAt[i] = -1;
+
+  // Each replaced call frees the three link cells, four for a procedure,
+  // under everything pushed between its INT and its ENTER
+  maxSize = codeSize;
+  for (k = 0; k < ctx->siteCount; k++)
+  {
+    site = ctx->sites + k;
+    siteAt[site->reserve] = k;
+    siteAt[site->call] = k;
+    saved = RESERVED_WORDS - ctx->table->subprograms[site->callee].isFunction;
+    shift[site->reserve + 1] += saved;
+    shift[site->call] -= saved;
+    maxSize += ctx->table->subprograms[site->callee].exit - ctx->table->subprograms[site->callee].entry + 1;
+  }
+  for (i = 1; i <= codeSize; i++)
+    shift[i] += shift[i - 1];
+
+  out = (Instruction *)malloc((maxSize + 1) * sizeof(Instruction));
+  remap = (char *)malloc((maxSize + 1) * sizeof(char));
+  outSize = 0;
+  for (i = 0; i < codeSize; i++)
+  {
+    newAddress[i] = outSize;
+    k = siteAt[i];
+    if (k < 0)
+    {
+      out[outSize] = code[i];
+      remap[outSize++] = isJumpOpCode(code[i].op);
+      continue;
+    }
+
+    site = ctx->sites + k;
+    s = ctx->table->subprograms[site->callee].isFunction;
+    if (i == site->reserve)
+    {
+      // Only a function needs its result cell
+      if (s > 0)
+      {
+        out[outSize] = code[i];
+        out[outSize].q = s;
+        remap[outSize++] = 0;
+      }
+    }
+    else
+      outSize = spliceBody(ctx, site, site->depth - shift[site->reserve], out, remap, outSize);
+  }
+  newAddress[codeSize] = outSize;
+
+  for (k = 0; k < outSize; k++)
+    if (remap[k] && (out[k].q >= 0) && (out[k].q <= codeSize))
+      out[k].q = newAddress[out[k].q];
+
+  for (k = 1; k < ctx->table->count; k++)
+    setCodeAddress(ctx->table->subprograms[k].owner, newAddress[ctx->table->subprograms[k].entry]);
+
+  free(codeBlock->code);
+  codeBlock->code = out;
+  codeBlock->codeSize = outSize;
+  codeBlock->maxSize = maxSize + 1;
+
+  free(siteAt);
+  free(shift);
+  free(newAddress);
+  free(remap);
+  return ctx->siteCount;
+}
+
+/******************* Inlining ******************************/
+
+int inlineRound(CodeBlock *codeBlock, Object *program, int budget)
+{
+  InlineContext ctx;
+  int *depth;
+  int k, n;
+
+  ctx.codeBlock = codeBlock;
+  ctx.table = buildSubprogramTable(codeBlock, program);
+  ctx.inlinable = (char *)calloc(ctx.table->count, sizeof(char));
+  ctx.maxSites = 16;
+  ctx.siteCount = 0;
+  ctx.sites = (CallSite *)malloc(ctx.maxSites * sizeof(CallSite));
+  markInlinable(&ctx, budget);
+
+  depth = (int *)malloc((codeBlock->codeSize + 1) * sizeof(int));
+  for (k = 0; k <= codeBlock->codeSize; k++)
+    depth[k] = -1;
+  for (k = 0; k < ctx.table->count; k++)
+  {
+    computeStackDepths(&ctx, ctx.table->subprograms + k, depth);
+    findCallSites(&ctx, k, depth);
+  }
+  free(depth);
+
+  n = (ctx.siteCount > 0) ? inlineCallSites(&ctx) : 0;
+
+  freeSubprogramTable(ctx.table);
+  free(ctx.inlinable);
+  free(ctx.sites);
+  return n;
+}
+
+int inlineSubprograms(CodeBlock *codeBlock, Object *program, int budget)
+{
+  int total = 0;
+  int round, n;
+
+  // A copied body may hold calls that can be inlined in turn
+  for (round = 0; round < MAX_INLINE_ROUNDS; round++)
+  {
+    n = inlineRound(codeBlock, program, budget);
+    if (n == 0)
+      break;
+    total += n;
+  }
+  return total;
+}
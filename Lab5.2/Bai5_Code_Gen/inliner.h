@@ -0,0 +1,20 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INLINER_H__
+#define __INLINER_H__
+
+#include "symtab.h"
+#include "instructions.h"
+
+// Replaces calls to small non-recursive subprograms with copies of their
+// bodies. It runs once the whole program is parsed, while the symbol table
+// still knows where every subprogram starts. budget is the largest body,
+// in instructions, worth copying. Returns the number of calls replaced.
+
+int inlineSubprograms(CodeBlock* codeBlock, Object* program, int budget);
+
+#endif
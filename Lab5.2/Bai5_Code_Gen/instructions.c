@@ -23,11 +23,24 @@ void freeCodeBlock(CodeBlock* codeBlock) {
   free(codeBlock);
 }
 
+// Doubling keeps the total copying linear in the final code size
+int growCodeBlock(CodeBlock* codeBlock) {
+  int maxSize = (codeBlock->maxSize > 0) ? codeBlock->maxSize * 2 : MAX_BLOCK;
+  Instruction* code = (Instruction*) realloc(codeBlock->code, maxSize * sizeof(Instruction));
+
+  if (code == NULL) return 0;
+  codeBlock->code = code;
+  codeBlock->maxSize = maxSize;
+  return 1;
+}
+
 int emitCode(CodeBlock* codeBlock, enum OpCode op, WORD p, WORD q) {
-  Instruction* bottom = codeBlock->code + codeBlock->codeSize;
+  Instruction* bottom;
 
-  if (codeBlock->codeSize >= codeBlock->maxSize) return 0;
+  if ((codeBlock->codeSize >= codeBlock->maxSize) && !growCodeBlock(codeBlock))
+    return 0;
 
+  bottom = codeBlock->code + codeBlock->codeSize;
   bottom->op = op;
   bottom->p = p;
   bottom->q = q;
@@ -65,9 +78,47 @@ int emitGT(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_GT, DC_VALUE, D
 int emitLT(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_LT, DC_VALUE, DC_VALUE); }
 int emitGE(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_GE, DC_VALUE, DC_VALUE); }
 int emitLE(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_LE, DC_VALUE, DC_VALUE); }
+int emitJEQ(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JEQ, DC_VALUE, q); }
+int emitJNE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JNE, DC_VALUE, q); }
+int emitJGT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JGT, DC_VALUE, q); }
+int emitJLT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JLT, DC_VALUE, q); }
+int emitJGE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JGE, DC_VALUE, q); }
+int emitJLE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JLE, DC_VALUE, q); }
+int emitENTER(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_ENTER, p, q); }
+int emitINCV(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_INCV, p, q); }
+int emitENTERL(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_ENTERL, DC_VALUE, q); }
 
 int emitBP(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_BP, DC_VALUE, DC_VALUE); }
 
+int isJumpOpCode(enum OpCode op) {
+  return ((op >= OP_JEQ) && (op <= OP_JLE)) || (op == OP_J) || (op == OP_FJ) || (op == OP_CALL) || (op == OP_ENTER) || (op == OP_ENTERL);
+}
+
+// The compare-and-jump taken exactly when the comparison op is true
+enum OpCode compareJump(enum OpCode op) {
+  switch (op) {
+  case OP_EQ: return OP_JEQ;
+  case OP_NE: return OP_JNE;
+  case OP_GT: return OP_JGT;
+  case OP_LT: return OP_JLT;
+  case OP_GE: return OP_JGE;
+  case OP_LE: return OP_JLE;
+  default: return OP_FJ;
+  }
+}
+
+// The compare-and-jump taken exactly when the comparison op is false
+enum OpCode negateCompareJump(enum OpCode op) {
+  switch (op) {
+  case OP_EQ: return OP_JNE;
+  case OP_NE: return OP_JEQ;
+  case OP_GT: return OP_JLE;
+  case OP_LT: return OP_JGE;
+  case OP_GE: return OP_JLT;
+  case OP_LE: return OP_JGT;
+  default: return OP_FJ;
+  }
+}
 
 void printInstruction(Instruction* inst) {
   switch (inst->op) {
@@ -101,6 +152,15 @@ void printInstruction(Instruction* inst) {
   case OP_LT: printf("LT"); break;
   case OP_GE: printf("GE"); break;
   case OP_LE: printf("LE"); break;
+  case OP_JEQ: printf("JEQ %d", inst->q); break;
+  case OP_JNE: printf("JNE %d", inst->q); break;
+  case OP_JGT: printf("JGT %d", inst->q); break;
+  case OP_JLT: printf("JLT %d", inst->q); break;
+  case OP_JGE: printf("JGE %d", inst->q); break;
+  case OP_JLE: printf("JLE %d", inst->q); break;
+  case OP_ENTER: printf("ENTER %d,%d", inst->p, inst->q); break;
+  case OP_INCV: printf("INCV %d,%d", inst->p, inst->q); break;
+  case OP_ENTERL: printf("ENTERL %d", inst->q); break;
 
   case OP_BP: printf("BP"); break;
   default: break;
@@ -120,13 +180,18 @@ void printCodeBlock(CodeBlock* codeBlock) {
 
 
 void loadCode(CodeBlock* codeBlock, FILE* f) {
-  Instruction* code = codeBlock->code;
   int n;
 
   codeBlock->codeSize = 0;
   while (!feof(f)) {
-    n = fread(code, sizeof(Instruction), MAX_BLOCK, f);
-    code += n;
+    if ((codeBlock->codeSize >= codeBlock->maxSize) && !growCodeBlock(codeBlock))
+      return;
+    n = codeBlock->maxSize - codeBlock->codeSize;
+    if (n > MAX_BLOCK)
+      n = MAX_BLOCK;
+    n = fread(codeBlock->code + codeBlock->codeSize, sizeof(Instruction), n, f);
+    if (n == 0)
+      break;
     codeBlock->codeSize += n;
   }
 }
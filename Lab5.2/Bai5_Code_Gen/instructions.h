@@ -31,8 +31,8 @@ enum OpCode {
   OP_CALL, // Call             s[t+2] := b; s[t+3] := pc; s[t+4]:= base(p); b:=t+1; pc:=q;
   OP_EP,   // Exit Procedure   t := b - 1;  pc := s[b+2];  b := s[b+1];
   OP_EF,   // Exit Function    t := b;  pc := s[b+2];  b := s[b+1];
-  OP_RC,   // Read Char        read one character into s[s[t]];  t := t - 1;
-  OP_RI,   // Read Integer     read integer to s[s[t]];  t := t-1;
+  OP_RC,   // Read Char        t := t + 1; read one character into s[t];
+  OP_RI,   // Read Integer     t := t + 1; read integer into s[t];
   OP_WRC,  // Write Char       write one character from s[t];  t := t-1;
   OP_WRI,  // Write Int        write integer from s[t];  t := t-1;
   OP_WLN,  // WriteLN          CR/LF
@@ -47,7 +47,20 @@ enum OpCode {
   OP_GT,   // Greater          t := t - 1;  if s[t] > s[t+1] then s[t] := 1 else s[t] := 0;
   OP_LT,   // Less             t := t - 1;  if s[t] < s[t+1] then s[t] := 1 else s[t] := 0;
   OP_GE,   // Greater or Equal t := t - 1;  if s[t] >= s[t+1] then s[t] := 1 else s[t] := 0;
-  OP_LE,   // Less or Equal    t := t - 1;  if s[t] >= s[t+1] then s[t] := 1 else s[t] := 0;
+  OP_LE,   // Less or Equal    t := t - 1;  if s[t] <= s[t+1] then s[t] := 1 else s[t] := 0;
+  OP_JEQ,  // Jump if Equal    t := t - 2;  if s[t+1] = s[t+2] then pc := q;
+  OP_JNE,  // Jump if Not Equal t := t - 2; if s[t+1] != s[t+2] then pc := q;
+  OP_JGT,  // Jump if Greater  t := t - 2;  if s[t+1] > s[t+2] then pc := q;
+  OP_JLT,  // Jump if Less     t := t - 2;  if s[t+1] < s[t+2] then pc := q;
+  OP_JGE,  // Jump if Greater or Equal  t := t - 2;  if s[t+1] >= s[t+2] then pc := q;
+  OP_JLE,  // Jump if Less or Equal     t := t - 2;  if s[t+1] <= s[t+2] then pc := q;
+  OP_ENTER,// Call and set up the frame, with the arguments already pushed:
+           //   n := code[q].p; b' := t - 3 - n; s[b'+1] := b; s[b'+2] := pc; s[b'+3] := base(p);
+           //   b := b'; t := b - 1 + code[q].q; pc := q + 1;
+           // code[q] is the INT of the callee, which carries its parameter count in p
+  OP_INCV, // Increment Variable  s[b + q] := s[b + q] + p;  (a slot of the current frame)
+  OP_ENTERL,// ENTER for a callee that never follows its static link: the same
+           // frame set up, but base(p) is not computed and s[b'+3] is left unset
 
   OP_BP    // Break point. Just for debugging
 };
@@ -64,7 +77,7 @@ typedef int CodeAddress;
 struct CodeBlock_ {
   Instruction* code;
   int codeSize;
-  int maxSize;
+  int maxSize;            // allocated slots, the block grows as code is emitted
 };
 
 typedef struct CodeBlock_ CodeBlock;
@@ -104,9 +117,22 @@ int emitGT(CodeBlock* codeBlock);
 int emitLT(CodeBlock* codeBlock);
 int emitGE(CodeBlock* codeBlock);
 int emitLE(CodeBlock* codeBlock);
+int emitJEQ(CodeBlock* codeBlock, WORD q);
+int emitJNE(CodeBlock* codeBlock, WORD q);
+int emitJGT(CodeBlock* codeBlock, WORD q);
+int emitJLT(CodeBlock* codeBlock, WORD q);
+int emitJGE(CodeBlock* codeBlock, WORD q);
+int emitJLE(CodeBlock* codeBlock, WORD q);
+int emitENTER(CodeBlock* codeBlock, WORD p, WORD q);
+int emitINCV(CodeBlock* codeBlock, WORD p, WORD q);
+int emitENTERL(CodeBlock* codeBlock, WORD q);
 
 int emitBP(CodeBlock* codeBlock);
 
+int isJumpOpCode(enum OpCode op);
+enum OpCode compareJump(enum OpCode op);
+enum OpCode negateCompareJump(enum OpCode op);
+
 void printInstruction(Instruction* instruction);
 void printCodeBlock(CodeBlock* codeBlock);
 
@@ -0,0 +1,98 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "arena.h"
+
+#define INITIAL_INTERN_SIZE 256
+
+// Identifiers only contain letters and digits, so clearing bit 5 folds
+// lower case letters without making two different characters equal
+#define FOLD(c) ((c) & 0xDF)
+
+Arena internArena;              // the interned strings themselves
+char** internSlots = NULL;      // open addressing, NULL marks an empty slot
+unsigned internSize = 0;        // always a power of two
+unsigned internCount = 0;
+
+unsigned hashIdent(char* name) {
+  unsigned h = 2166136261u;
+
+  while (*name != '\0') {
+    h = (h ^ (unsigned char) FOLD(*name)) * 16777619u;
+    name ++;
+  }
+  return h;
+}
+
+int equalIdent(char* s1, char* s2) {
+  while (FOLD(*s1) == FOLD(*s2)) {
+    if (*s1 == '\0')
+      return 1;
+    s1 ++;
+    s2 ++;
+  }
+  return 0;
+}
+
+void initInternTable(void) {
+  internSize = INITIAL_INTERN_SIZE;
+  internCount = 0;
+  initArena(&internArena);
+  internSlots = (char**) calloc(internSize, sizeof(char*));
+}
+
+void cleanInternTable(void) {
+  freeArena(&internArena);
+  free(internSlots);
+  internSlots = NULL;
+  internSize = 0;
+  internCount = 0;
+}
+
+void growInternTable(void) {
+  char** oldSlots = internSlots;
+  unsigned oldSize = internSize;
+  unsigned i, j;
+
+  internSize = oldSize * 2;
+  internSlots = (char**) calloc(internSize, sizeof(char*));
+  for (i = 0; i < oldSize; i ++)
+    if (oldSlots[i] != NULL) {
+      j = hashIdent(oldSlots[i]) & (internSize - 1);
+      while (internSlots[j] != NULL)
+        j = (j + 1) & (internSize - 1);
+      internSlots[j] = oldSlots[i];
+    }
+  free(oldSlots);
+}
+
+char* internIdent(char* name) {
+  unsigned i;
+  char* ident;
+
+  if (internSlots == NULL)
+    initInternTable();
+
+  i = hashIdent(name) & (internSize - 1);
+  while (internSlots[i] != NULL) {
+    if (equalIdent(internSlots[i], name))
+      return internSlots[i];
+    i = (i + 1) & (internSize - 1);
+  }
+
+  ident = (char*) arenaAlloc(&internArena, strlen(name) + 1);
+  strcpy(ident, name);
+  internSlots[i] = ident;
+  internCount ++;
+
+  // Keep the load factor under one half so that probe sequences stay short
+  if (internCount * 2 > internSize)
+    growInternTable();
+  return ident;
+}
@@ -0,0 +1,18 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+// Identifiers are case-insensitive. Interning maps every spelling of a name
+// to one canonical string (the first spelling seen), so the symbol table can
+// compare names by pointer instead of with strcasecmp.
+
+void initInternTable(void);
+void cleanInternTable(void);
+char* internIdent(char* name);
+
+#endif
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "reader.h"
 #include "parser.h"
@@ -14,19 +15,37 @@
 
 
 int dumpCode = 0;
+int optimize = 0;
+int inlineBudget = 24;      // largest subprogram body inlined under -O
 
 void printUsage(void) {
-  printf("Usage: kplc input output [-dump]\n");
+  printf("Usage: kplc input output [-dump] [-O] [-inline=N]\n");
   printf("   input: input kpl program\n");
   printf("   output: executable\n");
   printf("   -dump: code dump\n");
+  printf("   -O: optimize the generated code\n");
+  printf("   -inline=N: with -O, inline subprograms of at most N instructions (0: none)\n");
 }
 
 int analyseParam(char* param) {
+  char* end;
+  long budget;
+
   if (strcmp(param, "-dump") == 0) {
     dumpCode = 1;
     return 1;
   } 
+  if (strcmp(param, "-O") == 0) {
+    optimize = 1;
+    return 1;
+  }
+  if (strncmp(param, "-inline=", 8) == 0) {
+    budget = strtol(param + 8, &end, 10);
+    if ((end == param + 8) || (*end != '\0') || (budget < 0) || (budget > INT_MAX))
+      return 0;
+    inlineBudget = (int) budget;
+    return 1;
+  }
   return 0;
 }
 
@@ -49,7 +68,11 @@ int main(int argc, char *argv[]) {
   }
 
   for ( i = 3; i < argc; i ++) 
-    analyseParam(argv[i]);
+    if (!analyseParam(argv[i])) {
+      printf("kplc: invalid option %s\n", argv[i]);
+      printUsage();
+      return -1;
+    }
 
   initCodeBuffer();
 
@@ -58,6 +81,9 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  if (optimize)
+    optimizeCodeBuffer();
+
   if (serialize(argv[2]) == IO_ERROR) {
     printf("Can\'t write output file!\n");
     return -1;
@@ -0,0 +1,500 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "optimizer.h"
+#include "cfg.h"
+
+#define MAX_WINDOW 5
+#define MAX_PEEPHOLE_PASSES 10
+
+/******************* Jump targets ******************************/
+
+int isJumpInstruction(Instruction *inst)
+{
+  return isJumpOpCode(inst->op);
+}
+
+// An instruction is a target when control can arrive there other than by
+// falling through: a jump or call target, or the return point after a call.
+char *findJumpTargets(CodeBlock *codeBlock)
+{
+  char *isTarget = (char *)calloc(codeBlock->codeSize + 1, sizeof(char));
+  Instruction *inst;
+  int i;
+
+  isTarget[0] = 1;
+  for (i = 0; i < codeBlock->codeSize; i++)
+  {
+    inst = codeBlock->code + i;
+    if (isJumpInstruction(inst) && (inst->q >= 0) && (inst->q <= codeBlock->codeSize))
+      isTarget[inst->q] = 1;
+    if ((inst->op == OP_CALL) || (inst->op == OP_ENTER) || (inst->op == OP_ENTERL))
+      isTarget[i + 1] = 1;
+  }
+  return isTarget;
+}
+
+/******************* Peephole rules ******************************/
+
+// Arithmetic as the VM does it: wrapping, with x / -1 as a negation.
+// NEG ignores b.
+WORD foldArithmetic(enum OpCode op, WORD a, WORD b)
+{
+  switch (op)
+  {
+  case OP_AD:
+    return (WORD)((unsigned)a + (unsigned)b);
+  case OP_SB:
+    return (WORD)((unsigned)a - (unsigned)b);
+  case OP_ML:
+    return (WORD)((unsigned)a * (unsigned)b);
+  case OP_DV:
+    return (b == -1) ? (WORD)(0u - (unsigned)a) : a / b;
+  case OP_NEG:
+    return (WORD)(0u - (unsigned)a);
+  default:
+    return 0;
+  }
+}
+
+// A rewrite looks at a window that matched the rule's opcodes and either
+// returns -1 to decline, or stores the replacement and returns its length.
+typedef int (*Rewrite)(Instruction *window, Instruction *result);
+
+int dropNeutralConstant(Instruction *w, Instruction *r)
+{
+  (void)r;
+  // x + 0, x - 0, x * 1, x / 1
+  if (((w[1].op == OP_AD) || (w[1].op == OP_SB)) && (w[0].q == 0))
+    return 0;
+  if (((w[1].op == OP_ML) || (w[1].op == OP_DV)) && (w[0].q == 1))
+    return 0;
+  return -1;
+}
+
+int foldConstants(Instruction *w, Instruction *r)
+{
+  // Leave a division by zero for the VM to report
+  if ((w[2].op == OP_DV) && (w[1].q == 0))
+    return -1;
+  r[0] = w[0];
+  r[0].q = foldArithmetic(w[2].op, w[0].q, w[1].q);
+  return 1;
+}
+
+int foldNegatedConstant(Instruction *w, Instruction *r)
+{
+  r[0] = w[0];
+  r[0].q = foldArithmetic(OP_NEG, w[0].q, 0);
+  return 1;
+}
+
+int dropDoubleNegation(Instruction *w, Instruction *r)
+{
+  (void)w;
+  (void)r;
+  return 0;
+}
+
+int foldAddressOffset(Instruction *w, Instruction *r)
+{
+  // LA p,q; LC k; AD  =>  LA p,q+k
+  r[0] = w[0];
+  r[0].q = w[0].q + w[1].q;
+  return 1;
+}
+
+int foldIndexBase(Instruction *w, Instruction *r)
+{
+  // LA p,q; LV a,b; LC k; SB; AD  =>  LA p,q-k; LV a,b; AD
+  // which is how an element address base + (i - 1) * 1 starts out
+  r[0] = w[0];
+  r[0].q = w[0].q - w[2].q;
+  r[1] = w[1];
+  r[2] = w[4];
+  return 3;
+}
+
+int fuseIncrement(Instruction *w, Instruction *r)
+{
+  // LA 0,q; LV 0,q; LC k; AD  ST  =>  INCV k,q  (and SB steps by -k)
+  if ((w[0].p != 0) || (w[1].p != 0) || (w[0].q != w[1].q))
+    return -1;
+  r[0].op = OP_INCV;
+  r[0].p = (w[3].op == OP_AD) ? w[2].q : foldArithmetic(OP_NEG, w[2].q, 0);
+  r[0].q = w[0].q;
+  return 1;
+}
+
+int fuseLoadAddress(Instruction *w, Instruction *r)
+{
+  // LA p,q; LI  =>  LV p,q
+  r[0] = w[0];
+  r[0].op = OP_LV;
+  return 1;
+}
+
+int mergeStackAdjustments(Instruction *w, Instruction *r)
+{
+  int delta = ((w[0].op == OP_INT) ? w[0].q : -w[0].q) + ((w[1].op == OP_INT) ? w[1].q : -w[1].q);
+
+  if (delta == 0)
+    return 0;
+  r[0] = w[0];
+  r[0].op = (delta > 0) ? OP_INT : OP_DCT;
+  r[0].q = (delta > 0) ? delta : -delta;
+  return 1;
+}
+
+int dropEmptyAdjustment(Instruction *w, Instruction *r)
+{
+  (void)r;
+  return (w[0].q == 0) ? 0 : -1;
+}
+
+typedef struct
+{
+  int length;
+  enum OpCode pattern[MAX_WINDOW];
+  Rewrite rewrite;
+} PeepholeRule;
+
+PeepholeRule peepholeRules[] = {
+    {2, {OP_LC, OP_AD}, dropNeutralConstant},
+    {2, {OP_LC, OP_SB}, dropNeutralConstant},
+    {2, {OP_LC, OP_ML}, dropNeutralConstant},
+    {2, {OP_LC, OP_DV}, dropNeutralConstant},
+    {3, {OP_LC, OP_LC, OP_AD}, foldConstants},
+    {3, {OP_LC, OP_LC, OP_SB}, foldConstants},
+    {3, {OP_LC, OP_LC, OP_ML}, foldConstants},
+    {3, {OP_LC, OP_LC, OP_DV}, foldConstants},
+    {2, {OP_LC, OP_NEG}, foldNegatedConstant},
+    {2, {OP_NEG, OP_NEG}, dropDoubleNegation},
+    {3, {OP_LA, OP_LC, OP_AD}, foldAddressOffset},
+    {5, {OP_LA, OP_LV, OP_LC, OP_SB, OP_AD}, foldIndexBase},
+    {5, {OP_LA, OP_LV, OP_LC, OP_AD, OP_ST}, fuseIncrement},
+    {5, {OP_LA, OP_LV, OP_LC, OP_SB, OP_ST}, fuseIncrement},
+    {2, {OP_LA, OP_LI}, fuseLoadAddress},
+    {2, {OP_INT, OP_INT}, mergeStackAdjustments},
+    {2, {OP_INT, OP_DCT}, mergeStackAdjustments},
+    {2, {OP_DCT, OP_INT}, mergeStackAdjustments},
+    {2, {OP_DCT, OP_DCT}, mergeStackAdjustments},
+    {1, {OP_INT}, dropEmptyAdjustment},
+    {1, {OP_DCT}, dropEmptyAdjustment},
+};
+
+#define PEEPHOLE_RULE_COUNT (sizeof(peepholeRules) / sizeof(PeepholeRule))
+
+/******************* Peephole pass ******************************/
+
+// Try every rule on the instructions that end the output. A window may only
+// start at a jump target, never contain one further in.
+int rewriteTail(Instruction *out, char *outTarget, int *outSize, int *pendingTarget)
+{
+  Instruction result[MAX_WINDOW];
+  int i, k, n, start;
+
+  for (i = 0; i < (int)PEEPHOLE_RULE_COUNT; i++)
+  {
+    n = peepholeRules[i].length;
+    start = *outSize - n;
+    if (start < 0)
+      continue;
+    for (k = 0; k < n; k++)
+      if ((out[start + k].op != peepholeRules[i].pattern[k]) || ((k > 0) && outTarget[start + k]))
+        break;
+    if (k < n)
+      continue;
+
+    k = peepholeRules[i].rewrite(out + start, result);
+    if (k < 0)
+      continue;
+
+    memcpy(out + start, result, k * sizeof(Instruction));
+    // When the whole window goes, its target mark moves on to the next instruction
+    if (k == 0)
+      *pendingTarget |= outTarget[start];
+    *outSize = start + k;
+    return 1;
+  }
+  return 0;
+}
+
+int peepholePass(CodeBlock *codeBlock)
+{
+  int codeSize = codeBlock->codeSize;
+  Instruction *code = codeBlock->code;
+  Instruction *out = (Instruction *)malloc((codeSize + 1) * sizeof(Instruction));
+  char *isTarget = findJumpTargets(codeBlock);
+  char *outTarget = (char *)calloc(codeSize + 1, sizeof(char));
+  int *newAddress = (int *)malloc((codeSize + 1) * sizeof(int));
+  int pendingTarget = 0;
+  int outSize = 0;
+  int i;
+
+  for (i = 0; i < codeSize; i++)
+  {
+    newAddress[i] = outSize;
+
+    // A jump to the next instruction does nothing
+    if ((code[i].op == OP_J) && (code[i].q == i + 1))
+    {
+      pendingTarget |= isTarget[i];
+      continue;
+    }
+
+    out[outSize] = code[i];
+    outTarget[outSize] = isTarget[i] | pendingTarget;
+    pendingTarget = 0;
+    outSize++;
+
+    while (rewriteTail(out, outTarget, &outSize, &pendingTarget))
+      ;
+  }
+  newAddress[codeSize] = outSize;
+
+  for (i = 0; i < outSize; i++)
+    if (isJumpInstruction(out + i))
+      out[i].q = newAddress[out[i].q];
+
+  i = codeSize - outSize;
+  memcpy(code, out, outSize * sizeof(Instruction));
+  codeBlock->codeSize = outSize;
+
+  free(out);
+  free(isTarget);
+  free(outTarget);
+  free(newAddress);
+  return i;
+}
+
+int peepholeOptimize(CodeBlock *codeBlock)
+{
+  int removed = 0;
+  int pass, n;
+
+  // Rewrites can expose new windows, e.g. by removing a jump to the next instruction
+  for (pass = 0; pass < MAX_PEEPHOLE_PASSES; pass++)
+  {
+    n = peepholePass(codeBlock);
+    if (n == 0)
+      break;
+    removed += n;
+  }
+  return removed;
+}
+
+/******************* Dead code ******************************/
+
+int compareJumpTaken(enum OpCode op, WORD a, WORD b)
+{
+  switch (op)
+  {
+  case OP_JEQ:
+    return a == b;
+  case OP_JNE:
+    return a != b;
+  case OP_JGT:
+    return a > b;
+  case OP_JLT:
+    return a < b;
+  case OP_JGE:
+    return a >= b;
+  default:
+    return a <= b;
+  }
+}
+
+// A conditional jump on constants, e.g. from IF K > 0 with K a constant,
+// becomes a J to where it always goes and its operands are removed.
+void decideConstantJumps(CodeBlock *codeBlock, char *removed)
+{
+  Instruction *code = codeBlock->code;
+  char *isTarget = findJumpTargets(codeBlock);
+  int taken;
+  int i;
+
+  for (i = 1; i < codeBlock->codeSize; i++)
+  {
+    if (isTarget[i])
+      continue;
+    if ((code[i].op == OP_FJ) && (code[i - 1].op == OP_LC))
+    {
+      taken = (code[i - 1].q == 0);
+      removed[i - 1] = 1;
+    }
+    else if ((code[i].op >= OP_JEQ) && (code[i].op <= OP_JLE) && (i >= 2) && !isTarget[i - 1] &&
+             (code[i - 2].op == OP_LC) && (code[i - 1].op == OP_LC))
+    {
+      taken = compareJumpTaken(code[i].op, code[i - 2].q, code[i - 1].q);
+      removed[i - 2] = 1;
+      removed[i - 1] = 1;
+    }
+    else
+      continue;
+
+    code[i].op = OP_J;
+    if (!taken)
+      code[i].q = i + 1;
+  }
+  free(isTarget);
+}
+
+// Code that computes a value without side effects. DV is left out since it
+// may stop the program on a division by zero.
+int isPureCode(Instruction *code, CodeAddress start, CodeAddress end)
+{
+  CodeAddress i;
+
+  for (i = start; i < end; i++)
+    switch (code[i].op)
+    {
+    case OP_LA:
+    case OP_LV:
+    case OP_LC:
+    case OP_AD:
+    case OP_SB:
+    case OP_ML:
+    case OP_NEG:
+    case OP_EQ:
+    case OP_NE:
+    case OP_GT:
+    case OP_LT:
+    case OP_GE:
+    case OP_LE:
+      break;
+    default:
+      return 0;
+    }
+  return 1;
+}
+
+// Remove the blocks control never gets to, including whole subprograms that
+// are never called, and the stores to frame slots nobody reads afterwards
+int eliminateDeadCode(CodeBlock *codeBlock)
+{
+  Instruction *code = codeBlock->code;
+  char *removed = (char *)calloc(codeBlock->codeSize + 1, sizeof(char));
+  ControlFlowGraph *cfg;
+  BasicBlock *block;
+  SlotSet live;
+  CodeAddress i, link;
+  int b, n;
+
+  decideConstantJumps(codeBlock, removed);
+  cfg = buildControlFlowGraph(codeBlock);
+  markReachableBlocks(cfg);
+  computeLiveSlots(cfg);
+
+  for (b = 0; b < cfg->blockCount; b++)
+  {
+    block = cfg->blocks + b;
+    if (!block->reachable)
+    {
+      for (i = block->start; i < block->end; i++)
+        removed[i] = 1;
+      continue;
+    }
+
+    live = block->liveOut;
+    for (i = block->end - 1; i >= block->start; i--)
+    {
+      link = cfg->storeLink[i];
+      if ((code[i].op == OP_ST) && (link >= 0) && (code[link].q < SLOT_SET_SIZE) &&
+          !(live & slotBit(code[link].q)) && isPureCode(code, link + 1, i))
+      {
+        memset(removed + link, 1, i - link + 1);
+        i = link;
+        continue;
+      }
+      live = liveBefore(cfg, i, live);
+    }
+  }
+
+  freeControlFlowGraph(cfg);
+  n = linearizeCode(codeBlock, removed);
+  free(removed);
+  return n;
+}
+
+/******************* Jump threading ******************************/
+
+// Where a jump to address ends up once it has gone through every J it lands
+// on. Inside a cycle of Js, an empty endless loop, any address will do.
+CodeAddress finalTarget(Instruction *code, int codeSize, CodeAddress address)
+{
+  int steps = 0;
+
+  while ((address >= 0) && (address < codeSize) && (code[address].op == OP_J) && (steps++ < codeSize))
+    address = code[address].q;
+  return address;
+}
+
+int isReturnInstruction(Instruction *inst)
+{
+  return (inst->op == OP_EP) || (inst->op == OP_EF) || (inst->op == OP_HL);
+}
+
+// Send every jump straight to its final destination and remove the jumps
+// that are left going to the next instruction
+int threadJumps(CodeBlock *codeBlock)
+{
+  Instruction *code = codeBlock->code;
+  int codeSize = codeBlock->codeSize;
+  char *isTarget, *removed;
+  enum OpCode op;
+  int i, n, total;
+
+  for (i = 0; i < codeSize; i++)
+  {
+    op = code[i].op;
+    if ((op != OP_J) && (op != OP_FJ) && !((op >= OP_JEQ) && (op <= OP_JLE)))
+      continue;
+    code[i].q = finalTarget(code, codeSize, code[i].q);
+    // A J to a return or halt may as well do it
+    if ((op == OP_J) && (code[i].q >= 0) && (code[i].q < codeSize) && isReturnInstruction(code + code[i].q))
+      code[i] = code[code[i].q];
+  }
+
+  // Jcc L; J M; L:  =>  Jnot-cc M
+  isTarget = findJumpTargets(codeBlock);
+  for (i = 0; i + 1 < codeSize; i++)
+    if ((code[i].op >= OP_JEQ) && (code[i].op <= OP_JLE) && (code[i].q == i + 2) &&
+        (code[i + 1].op == OP_J) && !isTarget[i + 1])
+    {
+      code[i].op = negateCompareJump(OP_EQ + (code[i].op - OP_JEQ));
+      code[i].q = code[i + 1].q;
+      code[i + 1].q = i + 2;
+    }
+  free(isTarget);
+
+  // Removing one jump to the next instruction can make another one such
+  total = 0;
+  do
+  {
+    removed = (char *)calloc(codeBlock->codeSize + 1, sizeof(char));
+    for (i = 0; i < codeBlock->codeSize; i++)
+      if ((code[i].op == OP_J) && (code[i].q == i + 1))
+        removed[i] = 1;
+    n = linearizeCode(codeBlock, removed);
+    free(removed);
+    total += n;
+  } while (n > 0);
+  return total;
+}
+
+int optimizeCodeBlock(CodeBlock *codeBlock)
+{
+  int removed = eliminateDeadCode(codeBlock);
+
+  removed += peepholeOptimize(codeBlock);
+  removed += threadJumps(codeBlock);
+  // Threaded jumps can leave Js that nothing goes to any more
+  removed += eliminateDeadCode(codeBlock);
+  return removed + peepholeOptimize(codeBlock);
+}
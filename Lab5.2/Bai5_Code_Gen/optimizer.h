@@ -0,0 +1,23 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include "instructions.h"
+
+// Post-passes over a finished code block. Every pass keeps jump and
+// call targets pointing at the same code. Each returns the number of
+// instructions it removed.
+
+WORD foldArithmetic(enum OpCode op, WORD a, WORD b);
+
+int eliminateDeadCode(CodeBlock* codeBlock);
+int peepholeOptimize(CodeBlock* codeBlock);
+int threadJumps(CodeBlock* codeBlock);
+int optimizeCodeBlock(CodeBlock* codeBlock);
+
+#endif
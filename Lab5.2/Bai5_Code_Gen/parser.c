@@ -13,6 +13,7 @@
 #include "error.h"
 #include "debug.h"
 #include "codegen.h"
+#include "intern.h"
 
 Token *currentToken;
 Token *lookAhead;
@@ -20,13 +21,15 @@ Token *lookAhead;
 extern Type *intType;
 extern Type *charType;
 extern SymTab *symtab;
+extern int optimize;
+extern int inlineBudget;
 
 void scan(void)
 {
   Token *tmp = currentToken;
   currentToken = lookAhead;
   lookAhead = getValidToken();
-  free(tmp);
+  freeToken(tmp);
 }
 
 void eat(TokenType tokenType)
@@ -47,7 +50,7 @@ void compileProgram(void)
   eat(KW_PROGRAM);
   eat(TK_IDENT);
 
-  program = createProgramObject(currentToken->string);
+  program = createProgramObject(currentToken->ident);
   program->progAttrs->codeAddress = getCurrentCodeAddress();
   enterBlock(program->progAttrs->scope);
 
@@ -73,8 +76,8 @@ void compileConstDecls(void)
     do
     {
       eat(TK_IDENT);
-      checkFreshIdent(currentToken->string);
-      constObj = createConstantObject(currentToken->string);
+      checkFreshIdent(currentToken->ident);
+      constObj = createConstantObject(currentToken->ident);
       declareObject(constObj);
 
       eat(SB_EQ);
@@ -98,8 +101,8 @@ void compileTypeDecls(void)
     {
       eat(TK_IDENT);
 
-      checkFreshIdent(currentToken->string);
-      typeObj = createTypeObject(currentToken->string);
+      checkFreshIdent(currentToken->ident);
+      typeObj = createTypeObject(currentToken->ident);
       declareObject(typeObj);
 
       eat(SB_EQ);
@@ -122,8 +125,8 @@ void compileVarDecls(void)
     do
     {
       eat(TK_IDENT);
-      checkFreshIdent(currentToken->string);
-      varObj = createVariableObject(currentToken->string);
+      checkFreshIdent(currentToken->ident);
+      varObj = createVariableObject(currentToken->ident);
       eat(SB_COLON);
       varType = compileType();
       varObj->varAttrs->type = varType;
@@ -135,7 +138,12 @@ void compileVarDecls(void)
 
 void compileBlock(void)
 {
-  Instruction *jmp;
+  Object *owner = symtab->currentScope->owner;
+  Scope *scope;
+  CodeAddress jmp;
+  CodeAddress frame;
+  int paramCount = 0;
+  int selfCalls;
   // Jump to the body of the block
   jmp = genJ(DC_VALUE);
 
@@ -144,14 +152,46 @@ void compileBlock(void)
   compileVarDecls();
   compileSubDecls();
 
-  // Update the jmp label
-  updateJ(jmp, getCurrentCodeAddress());
+  frame = getCurrentCodeAddress();
+  if (frame == jmp + 1)
+  {
+    // No nested subprograms: the block starts right at its frame setup
+    discardCode(jmp);
+    frame = jmp;
+  }
+  else
+  {
+    // Update the jmp label
+    updateJ(jmp, frame);
+    // Nested subprograms calling this one were compiled against the jump
+    updateCALL(jmp + 1, jmp, frame);
+  }
+
+  // Calls enter the block right at its frame setup
+  if (owner->kind == OBJ_FUNCTION)
+  {
+    owner->funcAttrs->codeAddress = frame;
+    paramCount = owner->funcAttrs->paramCount;
+  }
+  else if (owner->kind == OBJ_PROCEDURE)
+  {
+    owner->procAttrs->codeAddress = frame;
+    paramCount = owner->procAttrs->paramCount;
+  }
+
   // Skip the stack frame
   genINT(symtab->currentScope->frameSize);
 
+  selfCalls = markSelfCalls();
   eat(KW_BEGIN);
   compileStatements();
   eat(KW_END);
+
+  // FOR loops reserve hidden slots while the statements are compiled
+  scope = symtab->currentScope;
+  updateFrame(frame, paramCount, (scope->maxFrameSize > scope->frameSize) ? scope->maxFrameSize : scope->frameSize);
+  if (owner->kind != OBJ_PROGRAM)
+    eliminateTailCalls(selfCalls, frame, paramCount, owner->kind == OBJ_FUNCTION);
 }
 
 void compileSubDecls(void)
@@ -173,8 +213,8 @@ void compileFuncDecl(void)
   eat(KW_FUNCTION);
   eat(TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  funcObj = createFunctionObject(currentToken->string);
+  checkFreshIdent(currentToken->ident);
+  funcObj = createFunctionObject(currentToken->ident);
   funcObj->funcAttrs->codeAddress = getCurrentCodeAddress();
   declareObject(funcObj);
 
@@ -205,8 +245,8 @@ void compileProcDecl(void)
   eat(KW_PROCEDURE);
   eat(TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  procObj = createProcedureObject(currentToken->string);
+  checkFreshIdent(currentToken->ident);
+  procObj = createProcedureObject(currentToken->ident);
   procObj->procAttrs->codeAddress = getCurrentCodeAddress();
   declareObject(procObj);
 
@@ -239,7 +279,7 @@ ConstantValue *compileUnsignedConstant(void)
   case TK_IDENT:
     eat(TK_IDENT);
 
-    obj = checkDeclaredConstant(currentToken->string);
+    obj = checkDeclaredConstant(currentToken->ident);
     constValue = duplicateConstantValue(obj->constAttrs->value);
 
     break;
@@ -293,7 +333,7 @@ ConstantValue *compileConstant2(void)
     break;
   case TK_IDENT:
     eat(TK_IDENT);
-    obj = checkDeclaredConstant(currentToken->string);
+    obj = checkDeclaredConstant(currentToken->ident);
     if (obj->constAttrs->value->type == TP_INT)
       constValue = duplicateConstantValue(obj->constAttrs->value);
     else
@@ -337,8 +377,8 @@ Type *compileType(void)
     break;
   case TK_IDENT:
     eat(TK_IDENT);
-    obj = checkDeclaredType(currentToken->string);
-    type = duplicateType(obj->typeAttrs->actualType);
+    obj = checkDeclaredType(currentToken->ident);
+    type = obj->typeAttrs->actualType;
     break;
   default:
     error(ERR_INVALID_TYPE, lookAhead->lineNo, lookAhead->colNo);
@@ -396,8 +436,8 @@ void compileParam(void)
   }
 
   eat(TK_IDENT);
-  checkFreshIdent(currentToken->string);
-  param = createParameterObject(currentToken->string, paramKind);
+  checkFreshIdent(currentToken->ident);
+  param = createParameterObject(currentToken->ident, paramKind);
   eat(SB_COLON);
   type = compileBasicType();
   param->paramAttrs->type = type;
@@ -455,11 +495,12 @@ Type *compileLValue(void)
 
   eat(TK_IDENT);
 
-  var = checkDeclaredLValueIdent(currentToken->string);
+  var = checkDeclaredLValueIdent(currentToken->ident);
 
   switch (var->kind)
   {
   case OBJ_VARIABLE:
+    invalidateInductionLoops(var);
     genVariableAddress(var);
     if (var->varAttrs->type->typeClass == TP_ARRAY)
     {
@@ -471,18 +512,14 @@ Type *compileLValue(void)
     break;
   case OBJ_PARAMETER:
   {
-    Scope *currentScope = symtab->currentScope;
-    Scope *paramScope = PARAMETER_SCOPE(var);
-    int level = 0;
-
-    while (currentScope != NULL && currentScope != paramScope)
-    {
-      level++;
-      currentScope = currentScope->outer;
-    }
+    int level = computeNestedLevel(PARAMETER_SCOPE(var));
 
     if (var->paramAttrs->kind == PARAM_REFERENCE)
+    {
+      // The argument may be any variable
+      invalidateInductionLoops(NULL);
       genLV(level, PARAMETER_OFFSET(var));
+    }
     else
       genLA(level, PARAMETER_OFFSET(var));
 
@@ -533,7 +570,7 @@ void compileCallSt(void)
   eat(KW_CALL);
   eat(TK_IDENT);
 
-  proc = checkDeclaredProcedure(currentToken->string);
+  proc = checkDeclaredProcedure(currentToken->ident);
 
   if (isPredefinedProcedure(proc))
   {
@@ -542,18 +579,18 @@ void compileCallSt(void)
   }
   else
   {
-    Scope *currentScope = symtab->currentScope;
-    Scope *procScope = PROCEDURE_SCOPE(proc);
-    int level = 0;
-
-    while (currentScope != NULL && currentScope != procScope)
-    {
-      level++;
-      currentScope = currentScope->outer;
-    }
+    // The static link points to the frame of the scope declaring the procedure
+    int level = computeNestedLevel(PROCEDURE_SCOPE(proc)->outer);
+    CodeAddress reserve = getCurrentCodeAddress();
 
+    // Reserve the frame header and push the arguments as the first locals;
+    // ENTER finds the new frame below them
+    genINT(RESERVED_WORDS);
     compileArguments(proc->procAttrs->paramList);
-    genCALL(level, proc->procAttrs->codeAddress);
+    genENTER(level, proc->procAttrs->codeAddress);
+    invalidateInductionLoops(NULL);
+    if (optimize && (proc == symtab->currentScope->owner))
+      recordSelfCall(reserve, getCurrentCodeAddress() - 1);
   }
 }
 
@@ -566,8 +603,8 @@ void compileGroupSt(void)
 
 void compileIfSt(void)
 {
-  Instruction *fjLabel;
-  Instruction *jLabel;
+  CodeAddress fjLabel;
+  CodeAddress jLabel;
 
   eat(KW_IF);
   compileCondition();
@@ -602,13 +639,37 @@ void compileIfSt(void)
 void compileWhileSt(void)
 {
   CodeAddress beginLoop;
-  Instruction *fjLabel;
+  CodeAddress fjLabel;
+  CodeAddress jmp;
+  Instruction *condition;
+  int conditionSize;
+  int selfCalls;
 
   eat(KW_WHILE);
 
+  selfCalls = markSelfCalls();
   beginLoop = getCurrentCodeAddress();
   compileCondition();
 
+  if (optimize)
+  {
+    // Rotate the loop: enter at the condition, which moves below the body
+    // and jumps back while it holds
+    dropInductionSites(beginLoop);
+    conditionSize = cutCode(beginLoop, &condition);
+    jmp = genJ(DC_VALUE);
+
+    eat(KW_DO);
+    beginLoop = getCurrentCodeAddress();
+    compileStatement();
+
+    updateJ(jmp, getCurrentCodeAddress());
+    pasteCode(condition, conditionSize);
+    genTJ(beginLoop);
+    dropSelfCalls(selfCalls);
+    return;
+  }
+
   // If condition is false, jump to end
   fjLabel = genFJ(DC_VALUE);
 
@@ -620,6 +681,7 @@ void compileWhileSt(void)
 
   // Update false jump to point to end
   updateFJ(fjLabel, getCurrentCodeAddress());
+  dropSelfCalls(selfCalls);
 }
 
 void compileForSt(void)
@@ -627,120 +689,100 @@ void compileForSt(void)
   Type *varType;
   Type *type;
   CodeAddress beginLoop;
-  Instruction *fjLabel;
+  CodeAddress fjLabel;
+  CodeAddress limitStart;
   Object *controlVar;
-  Token *varToken;
+  int limitOffset;
+  int constantLimit;
+  WORD limit;
+  InductionLoop loop;
+  int induction;
+  int selfCalls = markSelfCalls();
+  Scope *scope = symtab->currentScope;
+  int slotBase = scope->frameSize;
+  int maxFrameSize = scope->maxFrameSize;
 
   eat(KW_FOR);
   eat(TK_IDENT);
 
-  // Save the control variable
-  varToken = currentToken;
-  controlVar = checkDeclaredLValueIdent(currentToken->string);
-
-  // Generate code to store initial value
-  if (controlVar->kind == OBJ_VARIABLE)
-  {
-    genVariableAddress(controlVar);
-  }
-  else if (controlVar->kind == OBJ_PARAMETER)
-  {
-    Scope *currentScope = symtab->currentScope;
-    Scope *paramScope = PARAMETER_SCOPE(controlVar);
-    int level = 0;
-
-    while (currentScope != NULL && currentScope != paramScope)
-    {
-      level++;
-      currentScope = currentScope->outer;
-    }
-
-    if (controlVar->paramAttrs->kind == PARAM_REFERENCE)
-      genLV(level, PARAMETER_OFFSET(controlVar));
-    else
-      genLA(level, PARAMETER_OFFSET(controlVar));
-  }
-
+  controlVar = checkDeclaredLValueIdent(currentToken->ident);
   varType = (controlVar->kind == OBJ_VARIABLE) ? controlVar->varAttrs->type : controlVar->paramAttrs->type;
+  if (controlVar->kind == OBJ_VARIABLE)
+    invalidateInductionLoops(controlVar);
+  else if (controlVar->paramAttrs->kind == PARAM_REFERENCE)
+    invalidateInductionLoops(NULL);
 
+  // Store initial value
+  genControlAddress(controlVar);
   eat(SB_ASSIGN);
-
   type = compileExpression();
   checkTypeEquality(varType, type);
-
-  // Store initial value
   genST();
 
   eat(KW_TO);
 
-  // Begin of loop: load control variable value
-  beginLoop = getCurrentCodeAddress();
-  if (controlVar->kind == OBJ_VARIABLE)
-  {
-    genVariableValue(controlVar);
-  }
-  else if (controlVar->kind == OBJ_PARAMETER)
-  {
-    Scope *currentScope = symtab->currentScope;
-    Scope *paramScope = PARAMETER_SCOPE(controlVar);
-    int level = 0;
-
-    while (currentScope != NULL && currentScope != paramScope)
-    {
-      level++;
-      currentScope = currentScope->outer;
-    }
-
-    genLV(level, PARAMETER_OFFSET(controlVar));
-    genLI();
-  }
-
+  // The limit is evaluated once: a constant is used as is, anything else
+  // goes to a hidden slot of the current frame
+  limitOffset = symtab->currentScope->frameSize;
+  limitStart = getCurrentCodeAddress();
+  genLA(0, limitOffset);
   type = compileExpression();
   checkTypeEquality(varType, type);
+  constantLimit = isConstantCode(limitStart + 1, &limit);
+  if (constantLimit)
+    discardCode(limitStart);
+  else
+  {
+    genST();
+    symtab->currentScope->frameSize++;
+  }
 
-  // Compare: if control variable > limit, exit loop
+  // Enter the loop only if control variable <= limit
+  genControlValue(controlVar);
+  if (constantLimit)
+    genLC(limit);
+  else
+    genLV(0, limitOffset);
   genLE();
   fjLabel = genFJ(DC_VALUE);
 
   eat(KW_DO);
+  beginLoop = getCurrentCodeAddress();
+  induction = optimize && (controlVar->kind == OBJ_VARIABLE);
+  if (induction)
+    beginInductionLoop(&loop, controlVar);
+  // Loops in the body take their hidden slots above this one's and give
+  // them back; the running addresses, live across the whole body, go
+  // above the most the body used
+  scope->maxFrameSize = scope->frameSize;
   compileStatement();
+  scope->frameSize = scope->maxFrameSize;
+  if (induction)
+    beginLoop = endInductionLoop(&loop);
 
-  // Increment control variable
-  if (controlVar->kind == OBJ_VARIABLE)
-  {
-    genVariableAddress(controlVar);
-    genVariableValue(controlVar);
-  }
-  else if (controlVar->kind == OBJ_PARAMETER)
-  {
-    Scope *currentScope = symtab->currentScope;
-    Scope *paramScope = PARAMETER_SCOPE(controlVar);
-    int level = 0;
-
-    while (currentScope != NULL && currentScope != paramScope)
-    {
-      level++;
-      currentScope = currentScope->outer;
-    }
-
-    if (controlVar->paramAttrs->kind == PARAM_REFERENCE)
-      genLV(level, PARAMETER_OFFSET(controlVar));
-    else
-      genLA(level, PARAMETER_OFFSET(controlVar));
-
-    genLV(level, PARAMETER_OFFSET(controlVar));
-    genLI();
-  }
-
+  // Increment the control variable and go around again while it is <= limit
+  genControlAddress(controlVar);
+  genControlValue(controlVar);
   genLC(1);
   genAD();
   genST();
-
-  // Jump back to condition
-  genJ(beginLoop);
+  if (induction)
+    genInductionSteps(&loop);
+  genControlValue(controlVar);
+  if (constantLimit)
+    genLC(limit);
+  else
+    genLV(0, limitOffset);
+  genGT();
+  genFJ(beginLoop);
 
   // Update false jump to point to end
   updateFJ(fjLabel, getCurrentCodeAddress());
+  dropSelfCalls(selfCalls);
+
+  // The hidden slots are free again for the statements that follow
+  scope->maxFrameSize = (scope->frameSize > maxFrameSize) ? scope->frameSize : maxFrameSize;
+  scope->frameSize = slotBase;
 }
 
 void compileArgument(Object *param)
@@ -880,6 +922,7 @@ Type *compileExpression(void)
 {
   // TODO: generate code for expression
   Type *type;
+  CodeAddress start;
 
   switch (lookAhead->tokenType)
   {
@@ -890,8 +933,10 @@ Type *compileExpression(void)
     break;
   case SB_MINUS:
     eat(SB_MINUS);
+    start = getCurrentCodeAddress();
     type = compileExpression2();
-    genNEG();
+    if (!foldNegation(start))
+      genNEG();
     checkIntType(type);
     break;
   default:
@@ -915,24 +960,29 @@ Type *compileExpression3(Type *argType1)
   // TODO: generate code for expression3
   Type *argType2;
   Type *resultType;
+  CodeAddress rightStart;
 
   switch (lookAhead->tokenType)
   {
   case SB_PLUS:
     eat(SB_PLUS);
     checkIntType(argType1);
+    rightStart = getCurrentCodeAddress();
     argType2 = compileTerm();
-    genAD();
     checkIntType(argType2);
+    if (!foldBinaryOperation(OP_AD, rightStart))
+      genAD();
 
     resultType = compileExpression3(argType1);
     break;
   case SB_MINUS:
     eat(SB_MINUS);
     checkIntType(argType1);
+    rightStart = getCurrentCodeAddress();
     argType2 = compileTerm();
-    genSB();
     checkIntType(argType2);
+    if (!foldBinaryOperation(OP_SB, rightStart))
+      genSB();
 
     resultType = compileExpression3(argType1);
     break;
@@ -974,24 +1024,29 @@ Type *compileTerm2(Type *argType1)
   // TODO: generate code for term2
   Type *argType2;
   Type *resultType;
+  CodeAddress rightStart;
 
   switch (lookAhead->tokenType)
   {
   case SB_TIMES:
     eat(SB_TIMES);
     checkIntType(argType1);
+    rightStart = getCurrentCodeAddress();
     argType2 = compileFactor();
     checkIntType(argType2);
-    genML();
+    if (!foldBinaryOperation(OP_ML, rightStart))
+      genML();
 
     resultType = compileTerm2(argType1);
     break;
   case SB_SLASH:
     eat(SB_SLASH);
     checkIntType(argType1);
+    rightStart = getCurrentCodeAddress();
     argType2 = compileFactor();
     checkIntType(argType2);
-    genDV();
+    if (!foldBinaryOperation(OP_DV, rightStart))
+      genDV();
 
     resultType = compileTerm2(argType1);
     break;
@@ -1041,7 +1096,7 @@ Type *compileFactor(void)
     break;
   case TK_IDENT:
     eat(TK_IDENT);
-    obj = checkDeclaredIdent(currentToken->string);
+    obj = checkDeclaredIdent(currentToken->ident);
 
     switch (obj->kind)
     {
@@ -1072,15 +1127,7 @@ Type *compileFactor(void)
       break;
     case OBJ_PARAMETER:
     {
-      Scope *currentScope = symtab->currentScope;
-      Scope *paramScope = PARAMETER_SCOPE(obj);
-      int level = 0;
-
-      while (currentScope != NULL && currentScope != paramScope)
-      {
-        level++;
-        currentScope = currentScope->outer;
-      }
+      int level = computeNestedLevel(PARAMETER_SCOPE(obj));
 
       if (obj->paramAttrs->type->typeClass == TP_ARRAY)
       {
@@ -1093,8 +1140,10 @@ Type *compileFactor(void)
       }
       else
       {
+        // A reference parameter holds the address of the argument
         genLV(level, PARAMETER_OFFSET(obj));
-        genLI();
+        if (obj->paramAttrs->kind == PARAM_REFERENCE)
+          genLI();
         type = obj->paramAttrs->type;
       }
     }
@@ -1107,18 +1156,15 @@ Type *compileFactor(void)
       }
       else
       {
-        Scope *currentScope = symtab->currentScope;
-        Scope *funcScope = FUNCTION_SCOPE(obj);
-        int level = 0;
-
-        while (currentScope != NULL && currentScope != funcScope)
-        {
-          level++;
-          currentScope = currentScope->outer;
-        }
+        int level = computeNestedLevel(FUNCTION_SCOPE(obj)->outer);
+        CodeAddress reserve = getCurrentCodeAddress();
 
+        genINT(RESERVED_WORDS);
         compileArguments(obj->funcAttrs->paramList);
-        genCALL(level, obj->funcAttrs->codeAddress);
+        genENTER(level, obj->funcAttrs->codeAddress);
+        invalidateInductionLoops(NULL);
+        if (optimize && (obj == symtab->currentScope->owner))
+          recordSelfCall(reserve, getCurrentCodeAddress() - 1);
       }
       type = obj->funcAttrs->returnType;
       break;
@@ -1142,25 +1188,47 @@ Type *compileFactor(void)
 Type *compileIndexes(Type *arrayType)
 {
   Type *type;
+  CodeAddress base = getCurrentCodeAddress() - 1;
+  CodeAddress indexStart;
+  CodeAddress rightStart;
+  int elementSize;
+  WORD index;
+  WORD offset = 0;
 
   while (lookAhead->tokenType == SB_LSEL)
   {
     eat(SB_LSEL);
+    indexStart = getCurrentCodeAddress();
     type = compileExpression();
     checkIntType(type);
     checkArrayType(arrayType);
+    elementSize = sizeOfType(arrayType->elementType);
 
     // Calculate array element address
     // Address = base + (index - 1) * elementSize
-    genLC(1);
-    genSB(); // index - 1
-    genLC(sizeOfType(arrayType->elementType));
-    genML(); // (index - 1) * elementSize
-    genAD(); // base + offset
+    // The constant parts of all indexes are gathered in offset and added once
+    if (isConstantCode(indexStart, &index))
+    {
+      discardCode(indexStart);
+      offset += (index - 1) * elementSize;
+    }
+    else
+    {
+      if (peelConstantTerm(indexStart, &index))
+        offset += index * elementSize;
+      offset -= elementSize;
+      rightStart = getCurrentCodeAddress();
+      genLC(elementSize);
+      if (!foldBinaryOperation(OP_ML, rightStart))
+        genML(); // index * elementSize
+      genAD(); // base + offset
+    }
 
     arrayType = arrayType->elementType;
     eat(SB_RSEL);
   }
+  genAddressOffset(base, offset);
+  recordInductionSite(base);
   checkBasicType(arrayType);
   return arrayType;
 }
@@ -1170,6 +1238,7 @@ int compile(char *fileName)
   if (openInputStream(fileName) == IO_ERROR)
     return IO_ERROR;
 
+  initInternTable();
   currentToken = NULL;
   lookAhead = getValidToken();
 
@@ -1177,9 +1246,17 @@ int compile(char *fileName)
 
   compileProgram();
 
+  // The inliner finds the subprograms through the symbol table
+  if (optimize && (inlineBudget > 0))
+    inlineCodeBuffer(symtab->program, inlineBudget);
+  // Once the calls are inlined, fewer subprograms reach outer frames
+  if (optimize)
+    elideCodeBufferLinks(symtab->program);
+
   cleanSymTab();
-  free(currentToken);
-  free(lookAhead);
+  freeToken(currentToken);
+  freeToken(lookAhead);
+  cleanInternTable();
   closeInputStream();
   return IO_SUCCESS;
 }
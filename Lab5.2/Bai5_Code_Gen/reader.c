@@ -1,16 +1,25 @@
-/* 
+/*
  * @copyright (c) 2008, Hedspi, Hanoi University of Technology
  * @author Huu-Duc Nguyen
  * @version 1.0
  */
 
+// posix_madvise and friends are only declared for POSIX builds asking for them
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include "reader.h"
 
-FILE *inputStream;
 int lineNo, colNo;
 int currentChar;
 
+#ifdef _WIN32
+
+FILE *inputStream;
+
 int readChar(void) {
   currentChar = getc(inputStream);
   colNo ++;
@@ -35,3 +44,99 @@ void closeInputStream() {
   fclose(inputStream);
 }
 
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Size of a read(2) block when the input cannot be mapped (pipes, ttys, ...)
+#define READ_BLOCK_SIZE 65536
+
+int inputFd = -1;
+int inputMapped;
+size_t inputSize;
+unsigned char *inputBuffer;   // the whole file when mapped, one block otherwise
+unsigned char *inputPtr;
+unsigned char *inputEnd;
+
+int fillInputBuffer(void) {
+  ssize_t n;
+
+  if (inputMapped)
+    return 0;
+
+  do {
+    n = read(inputFd, inputBuffer, READ_BLOCK_SIZE);
+  } while ((n < 0) && (errno == EINTR));
+
+  if (n <= 0)
+    return 0;
+  inputPtr = inputBuffer;
+  inputEnd = inputBuffer + n;
+  return 1;
+}
+
+int readChar(void) {
+  if ((inputPtr < inputEnd) || fillInputBuffer())
+    currentChar = *inputPtr ++;
+  else
+    currentChar = EOF;
+  colNo ++;
+  if (currentChar == '\n') {
+    lineNo ++;
+    colNo = 0;
+  }
+  return currentChar;
+}
+
+int openInputStream(char *fileName) {
+  struct stat st;
+  void *map;
+
+  inputFd = open(fileName, O_RDONLY);
+  if (inputFd < 0)
+    return IO_ERROR;
+
+  inputMapped = 0;
+  if ((fstat(inputFd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, inputFd, 0);
+    if (map != MAP_FAILED) {
+      inputMapped = 1;
+      inputSize = st.st_size;
+      inputBuffer = (unsigned char *) map;
+      inputPtr = inputBuffer;
+      inputEnd = inputBuffer + inputSize;
+      posix_madvise(map, inputSize, POSIX_MADV_SEQUENTIAL);
+    }
+  }
+
+  if (!inputMapped) {
+    inputBuffer = (unsigned char *) malloc(READ_BLOCK_SIZE);
+    if (inputBuffer == NULL) {
+      close(inputFd);
+      return IO_ERROR;
+    }
+    inputPtr = inputBuffer;
+    inputEnd = inputBuffer;
+  }
+
+  lineNo = 1;
+  colNo = 0;
+  readChar();
+  return IO_SUCCESS;
+}
+
+void closeInputStream() {
+  if (inputMapped)
+    munmap(inputBuffer, inputSize);
+  else
+    free(inputBuffer);
+  inputBuffer = NULL;
+  close(inputFd);
+  inputFd = -1;
+}
+
+#endif
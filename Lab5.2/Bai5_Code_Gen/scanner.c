@@ -7,7 +7,6 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
 #include <stdlib.h>
-#include <conio.h>
 #include <ctype.h>
 #include <string.h>
 #include <limits.h>
@@ -15,6 +14,7 @@
 #include "charcode.h"
 #include "token.h"
 #include "error.h"
+#include "intern.h"
 
 
 extern int lineNo;
@@ -22,351 +22,380 @@ extern int colNo;
 extern int currentChar;
 
 extern CharCode charCodes[];
-int state;
-int ln, cn;
-char str[MAX_IDENT_LEN];
-char c;
+
+// Pseudo character class used for the end of the input
+#define CHAR_EOF (CHAR_UNKNOWN + 1)
+#define CHAR_CLASS_COUNT (CHAR_EOF + 1)
+
+// States of the lexer DFA. The ST_ states consume the current character
+// and stay in the loop; reaching an AC_ state leaves the loop and the
+// token is built from the characters consumed so far.
+typedef enum {
+	ST_START,
+	ST_IDENT,
+	ST_NUMBER,
+	ST_LT,
+	ST_GT,
+	ST_EXCLAIMATION,
+	ST_PERIOD,
+	ST_COLON,
+	ST_LPAR,
+	ST_COMMENT,
+	ST_COMMENT_STAR,
+
+	AC_EOF,
+	AC_IDENT,
+	AC_NUMBER,
+	AC_PLUS,
+	AC_MINUS,
+	AC_TIMES,
+	AC_SLASH,
+	AC_LT,
+	AC_LE,
+	AC_GT,
+	AC_GE,
+	AC_EQ,
+	AC_NEQ,
+	AC_BAD_NEQ,
+	AC_COMMA,
+	AC_PERIOD,
+	AC_RSEL,
+	AC_SEMICOLON,
+	AC_COLON,
+	AC_ASSIGN,
+	AC_CHAR,
+	AC_LPAR,
+	AC_LSEL,
+	AC_RPAR,
+	AC_BAD_COMMENT,
+	AC_BAD_SYMBOL
+} ScanState;
+
+#define FIRST_ACCEPT_STATE AC_EOF
+
+// The transitions expanded over every input byte, so that the hot loop does a
+// single lookup per character. Column 0 is EOF, column c + 1 is byte c.
+unsigned char scanTable[FIRST_ACCEPT_STATE][257];
+int scanTableReady = 0;
+
+const unsigned char transitions[FIRST_ACCEPT_STATE][CHAR_CLASS_COUNT] = {
+	/* ST_START */
+	{
+		ST_START /* space */, ST_IDENT /* letter */, ST_NUMBER /* digit */, AC_PLUS /* + */,
+		AC_MINUS /* - */, AC_TIMES /* * */, AC_SLASH /* / */, ST_LT /* < */,
+		ST_GT /* > */, ST_EXCLAIMATION /* ! */, AC_EQ /* = */, AC_COMMA /* , */,
+		ST_PERIOD /* . */, ST_COLON /* : */, AC_SEMICOLON /* ; */, AC_CHAR /* ' */,
+		ST_LPAR /* ( */, AC_RPAR /* ) */, AC_BAD_SYMBOL /* other */, AC_EOF /* EOF */
+	},
+	/* ST_IDENT */
+	{
+		AC_IDENT /* space */, ST_IDENT /* letter */, ST_IDENT /* digit */, AC_IDENT /* + */,
+		AC_IDENT /* - */, AC_IDENT /* * */, AC_IDENT /* / */, AC_IDENT /* < */,
+		AC_IDENT /* > */, AC_IDENT /* ! */, AC_IDENT /* = */, AC_IDENT /* , */,
+		AC_IDENT /* . */, AC_IDENT /* : */, AC_IDENT /* ; */, AC_IDENT /* ' */,
+		AC_IDENT /* ( */, AC_IDENT /* ) */, AC_IDENT /* other */, AC_IDENT /* EOF */
+	},
+	/* ST_NUMBER */
+	{
+		AC_NUMBER /* space */, AC_NUMBER /* letter */, ST_NUMBER /* digit */, AC_NUMBER /* + */,
+		AC_NUMBER /* - */, AC_NUMBER /* * */, AC_NUMBER /* / */, AC_NUMBER /* < */,
+		AC_NUMBER /* > */, AC_NUMBER /* ! */, AC_NUMBER /* = */, AC_NUMBER /* , */,
+		AC_NUMBER /* . */, AC_NUMBER /* : */, AC_NUMBER /* ; */, AC_NUMBER /* ' */,
+		AC_NUMBER /* ( */, AC_NUMBER /* ) */, AC_NUMBER /* other */, AC_NUMBER /* EOF */
+	},
+	/* ST_LT */
+	{
+		AC_LT /* space */, AC_LT /* letter */, AC_LT /* digit */, AC_LT /* + */,
+		AC_LT /* - */, AC_LT /* * */, AC_LT /* / */, AC_LT /* < */,
+		AC_LT /* > */, AC_LT /* ! */, AC_LE /* = */, AC_LT /* , */,
+		AC_LT /* . */, AC_LT /* : */, AC_LT /* ; */, AC_LT /* ' */,
+		AC_LT /* ( */, AC_LT /* ) */, AC_LT /* other */, AC_LT /* EOF */
+	},
+	/* ST_GT */
+	{
+		AC_GT /* space */, AC_GT /* letter */, AC_GT /* digit */, AC_GT /* + */,
+		AC_GT /* - */, AC_GT /* * */, AC_GT /* / */, AC_GT /* < */,
+		AC_GT /* > */, AC_GT /* ! */, AC_GE /* = */, AC_GT /* , */,
+		AC_GT /* . */, AC_GT /* : */, AC_GT /* ; */, AC_GT /* ' */,
+		AC_GT /* ( */, AC_GT /* ) */, AC_GT /* other */, AC_GT /* EOF */
+	},
+	/* ST_EXCLAIMATION */
+	{
+		AC_BAD_NEQ /* space */, AC_BAD_NEQ /* letter */, AC_BAD_NEQ /* digit */, AC_BAD_NEQ /* + */,
+		AC_BAD_NEQ /* - */, AC_BAD_NEQ /* * */, AC_BAD_NEQ /* / */, AC_BAD_NEQ /* < */,
+		AC_BAD_NEQ /* > */, AC_BAD_NEQ /* ! */, AC_NEQ /* = */, AC_BAD_NEQ /* , */,
+		AC_BAD_NEQ /* . */, AC_BAD_NEQ /* : */, AC_BAD_NEQ /* ; */, AC_BAD_NEQ /* ' */,
+		AC_BAD_NEQ /* ( */, AC_BAD_NEQ /* ) */, AC_BAD_NEQ /* other */, AC_BAD_NEQ /* EOF */
+	},
+	/* ST_PERIOD */
+	{
+		AC_PERIOD /* space */, AC_PERIOD /* letter */, AC_PERIOD /* digit */, AC_PERIOD /* + */,
+		AC_PERIOD /* - */, AC_PERIOD /* * */, AC_PERIOD /* / */, AC_PERIOD /* < */,
+		AC_PERIOD /* > */, AC_PERIOD /* ! */, AC_PERIOD /* = */, AC_PERIOD /* , */,
+		AC_PERIOD /* . */, AC_PERIOD /* : */, AC_PERIOD /* ; */, AC_PERIOD /* ' */,
+		AC_PERIOD /* ( */, AC_RSEL /* ) */, AC_PERIOD /* other */, AC_PERIOD /* EOF */
+	},
+	/* ST_COLON */
+	{
+		AC_COLON /* space */, AC_COLON /* letter */, AC_COLON /* digit */, AC_COLON /* + */,
+		AC_COLON /* - */, AC_COLON /* * */, AC_COLON /* / */, AC_COLON /* < */,
+		AC_COLON /* > */, AC_COLON /* ! */, AC_ASSIGN /* = */, AC_COLON /* , */,
+		AC_COLON /* . */, AC_COLON /* : */, AC_COLON /* ; */, AC_COLON /* ' */,
+		AC_COLON /* ( */, AC_COLON /* ) */, AC_COLON /* other */, AC_COLON /* EOF */
+	},
+	/* ST_LPAR */
+	{
+		AC_LPAR /* space */, AC_LPAR /* letter */, AC_LPAR /* digit */, AC_LPAR /* + */,
+		AC_LPAR /* - */, ST_COMMENT_STAR /* * */, AC_LPAR /* / */, AC_LPAR /* < */,
+		AC_LPAR /* > */, AC_LPAR /* ! */, AC_LPAR /* = */, AC_LPAR /* , */,
+		AC_LSEL /* . */, AC_LPAR /* : */, AC_LPAR /* ; */, AC_LPAR /* ' */,
+		AC_LPAR /* ( */, AC_LPAR /* ) */, AC_LPAR /* other */, AC_LPAR /* EOF */
+	},
+	/* ST_COMMENT */
+	{
+		ST_COMMENT /* space */, ST_COMMENT /* letter */, ST_COMMENT /* digit */, ST_COMMENT /* + */,
+		ST_COMMENT /* - */, ST_COMMENT_STAR /* * */, ST_COMMENT /* / */, ST_COMMENT /* < */,
+		ST_COMMENT /* > */, ST_COMMENT /* ! */, ST_COMMENT /* = */, ST_COMMENT /* , */,
+		ST_COMMENT /* . */, ST_COMMENT /* : */, ST_COMMENT /* ; */, ST_COMMENT /* ' */,
+		ST_COMMENT /* ( */, ST_COMMENT /* ) */, ST_COMMENT /* other */, AC_BAD_COMMENT /* EOF */
+	},
+	/* ST_COMMENT_STAR */
+	{
+		ST_COMMENT /* space */, ST_COMMENT /* letter */, ST_COMMENT /* digit */, ST_COMMENT /* + */,
+		ST_COMMENT /* - */, ST_COMMENT_STAR /* * */, ST_COMMENT /* / */, ST_COMMENT /* < */,
+		ST_COMMENT /* > */, ST_COMMENT /* ! */, ST_COMMENT /* = */, ST_COMMENT /* , */,
+		ST_COMMENT /* . */, ST_COMMENT /* : */, ST_COMMENT /* ; */, ST_COMMENT /* ' */,
+		ST_COMMENT /* ( */, ST_START /* ) */, ST_COMMENT /* other */, AC_BAD_COMMENT /* EOF */
+	}
+};
+
 /***************************************************************/
 
+void initScanTable(void)
+{
+	int state, i;
+
+	for (state = 0; state < FIRST_ACCEPT_STATE; state++)
+	{
+		scanTable[state][0] = transitions[state][CHAR_EOF];
+		for (i = 0; i < 256; i++)
+			scanTable[state][i + 1] = transitions[state][charCodes[i]];
+	}
+	scanTableReady = 1;
+}
 
-Token* getToken(void)
+Token* makeNumberToken(char* digits, int count, int ln, int cn)
 {
-	Token* token = (Token*)malloc(sizeof(Token));
-	int index;
-	switch (state)
+	char strNumber[11];
+	Token* token;
+
+	if (count > 10)
 	{
-	case 0:
-		if (currentChar == EOF) state = 1;
-		else
-			switch (charCodes[currentChar])
-			{
-			case CHAR_SPACE:
-				state = 2; break;
-			case CHAR_LETTER:
-				ln = lineNo;
-				cn = colNo;
-				state = 3;
-				break;
-			case CHAR_DIGIT:
-				state = 7;
-				break;
-			case CHAR_PLUS:
-				state = 9;
-				break;
-			case CHAR_MINUS:
-				state = 10;
-				break;
-			case CHAR_TIMES:
-				state = 11;
-				break;
-			case CHAR_SLASH:
-				state = 12;
-				break;
-			case CHAR_LT:
-				state = 13;
-				break;
-			case CHAR_GT:
-				state = 16;
-				break;
-			case CHAR_EQ:
-				state = 19;
-				break;
-			case CHAR_EXCLAIMATION:
-				state = 20;
-				break;
-			case CHAR_COMMA:
-				state = 23;
-				break;
-			case CHAR_PERIOD:
-				state = 24;
-				break;
-			case CHAR_SEMICOLON:
-				state = 27;
-				break;
-			case CHAR_COLON:
-				state = 28;
-				break;
-			case CHAR_SINGLEQUOTE:
-				state = 31;
-				break;
-			case CHAR_LPAR:
-				state = 35;
-				break;
-			case CHAR_RPAR:
-				state = 42;
-				break;
-			default:
-				state = 43;
-			}
-		return getToken();
-	case 1:
-		return makeToken(TK_EOF, lineNo, colNo);
-	case 2:
-		readChar();
-		state = 0;
-		return getToken();
-	case 3:
+		error(ERR_NUMBER_TOO_LONG, ln, cn);
+		return makeToken(TK_NONE, ln, cn);
+	}
+	if (count == 0)
 	{
-		ln = lineNo;
-		cn = colNo;
-		int count = 1;
-		str[0] = (char)currentChar;
-		readChar();
-		while ((currentChar != EOF) &&
-			((charCodes[currentChar] == CHAR_LETTER) || (charCodes[currentChar] == CHAR_DIGIT)))
+		digits[count++] = '0';
+	}
+	digits[count] = '\0';
+
+	sprintf(strNumber, "%d", INT_MAX);
+	if (strlen(digits) == strlen(strNumber) && strcmp(digits, strNumber) > 0)
+	{
+		error(ERR_NUMBER_TOO_LONG, ln, cn);
+		return makeToken(TK_NONE, ln, cn);
+	}
+	token = makeToken(TK_NUMBER, ln, cn);
+	strcpy(token->string, digits);
+	token->value = atoi(digits);
+	return token;
+}
+
+Token* makeCharToken(void)
+{
+	Token* token;
+	char c;
+
+	// currentChar follows the opening quote
+	if ((currentChar == EOF) || !isprint(currentChar))
+	{
+		error(ERR_INVALID_CONSTANT, lineNo, colNo - 2);
+		return makeToken(TK_NONE, lineNo, colNo);
+	}
+	c = (char)currentChar;
+	readChar();
+	if ((currentChar == EOF) || (charCodes[currentChar] != CHAR_SINGLEQUOTE))
+	{
+		error(ERR_INVALID_CONSTANT, lineNo, colNo - 2);
+		return makeToken(TK_NONE, lineNo, colNo);
+	}
+	token = makeToken(TK_CHAR, lineNo, colNo - 1);
+	token->string[0] = c;
+	token->string[1] = '\0';
+	readChar();
+	return token;
+}
+
+Token* getToken(void)
+{
+	Token* token;
+	char str[MAX_IDENT_LEN + 2];
+	int count = 0;
+	int ln = lineNo, cn = colNo;
+	int state = ST_START;
+	int next;
+
+	if (!scanTableReady)
+		initScanTable();
+
+	while (1)
+	{
+		next = scanTable[state][currentChar + 1];
+		if (next >= FIRST_ACCEPT_STATE)
+			break;
+
+		// Remember where the token starts
+		if ((state == ST_START) && (next != ST_START))
 		{
-			if (count <= MAX_IDENT_LEN)
-			{
-				str[count++] = (char)currentChar;
-			}
-			readChar();
+			ln = lineNo;
+			cn = colNo;
 		}
-		if (count > MAX_IDENT_LEN)
+		state = next;
+
+		// Consume characters for as long as the DFA stays in the same state
+		if (state == ST_IDENT)
 		{
-			error(ERR_IDENT_TOO_LONG, ln, cn);
-			return makeToken(TK_NONE, ln, cn);
+			do
+			{
+				// Characters past the limit are only counted, the error is reported at the end
+				if (count <= MAX_IDENT_LEN)
+					str[count++] = (char)currentChar;
+				readChar();
+			} while (scanTable[ST_IDENT][currentChar + 1] == ST_IDENT);
 		}
-		str[count] = '\0';
-		state = 4;
-		return getToken();
-	}
-	case 4:
-		token->tokenType = checkKeyword(str);
-		if (token->tokenType == TK_NONE) state = 5; else state = 6;
-		return getToken();
-	case 5:
-		token = makeToken(TK_IDENT, ln, cn);
-		strcpy(token->string, str);
-		return token;
-	case 6:
-		token = makeToken(checkKeyword(str), ln, cn);
-		return token;
-	case 7:
-		token = makeToken(TK_NONE, lineNo, colNo);
-		index = 0;
-		char string[11];
-		ln = lineNo;
-		cn = colNo;
-		while (currentChar == '0')
-			readChar();
-		while (currentChar != EOF && charCodes[currentChar] == CHAR_DIGIT)
+		else if (state == ST_NUMBER)
 		{
-			if (index >= 10)
+			do
 			{
-				while (currentChar != EOF && charCodes[currentChar] == CHAR_DIGIT)
+				// Leading zeros are not significant
+				if ((count > 0) || (currentChar != '0'))
 				{
-					index++;
-					readChar();
+					if (count < 10)
+						str[count] = (char)currentChar;
+					count++;
 				}
-				error(ERR_NUMBER_TOO_LONG, ln, cn);
-				return token;
-				break;
-			}
-			string[index] = currentChar;
-			index++;
-			readChar();
+				readChar();
+			} while (scanTable[ST_NUMBER][currentChar + 1] == ST_NUMBER);
 		}
-		if (index == 0)
+		else
 		{
-			token->tokenType = TK_NUMBER;
-			token->value = 0;
-			token->string[0] = '0';
-			token->string[1] = '\0';
-			return token;
+			do
+				readChar();
+			while (scanTable[state][currentChar + 1] == state);
 		}
+	}
 
-		string[index] = '\0';
-		char strNumber[11];
-		sprintf(strNumber, "%d", INT_MAX);
-		if (strlen(string) == strlen(strNumber) && strcmp(string, strNumber) > 0)
+	switch (next)
+	{
+	case AC_EOF:
+		return makeToken(TK_EOF, lineNo, colNo);
+	case AC_IDENT:
+		if (count > MAX_IDENT_LEN)
+		{
+			error(ERR_IDENT_TOO_LONG, ln, cn);
+			return makeToken(TK_NONE, ln, cn);
+		}
+		str[count] = '\0';
+		token = makeToken(checkKeyword(str), ln, cn);
+		if (token->tokenType == TK_NONE)
 		{
-			error(ERR_NUMBER_TOO_LONG, ln, cn);
-			return token;
+			token->tokenType = TK_IDENT;
+			strcpy(token->string, str);
+			token->ident = internIdent(str);
 		}
-		token->tokenType = TK_NUMBER;
-		strcpy(token->string, string);
-		token->value = atoi(string);
 		return token;
-	case 9:
+	case AC_NUMBER:
+		return makeNumberToken(str, count, ln, cn);
+	case AC_CHAR:
 		readChar();
-		return makeToken(SB_PLUS, lineNo, colNo - 1);
-	case 10:
+		return makeCharToken();
+	case AC_LT:
+		return makeToken(SB_LT, lineNo, colNo - 1);
+	case AC_GT:
+		return makeToken(SB_GT, lineNo, colNo - 1);
+	case AC_COLON:
+		return makeToken(SB_COLON, lineNo, colNo - 1);
+	case AC_LPAR:
+		return makeToken(SB_LPAR, ln, cn);
+	case AC_BAD_NEQ:
+		error(ERR_INVALID_SYMBOL, lineNo, colNo - 1);
+		return makeToken(TK_NONE, lineNo, colNo - 1);
+	case AC_BAD_COMMENT:
+		error(ERR_END_OF_COMMENT, lineNo, colNo);
+		return makeToken(TK_NONE, lineNo, colNo);
+	case AC_BAD_SYMBOL:
+		token = makeToken(TK_NONE, lineNo, colNo);
+		error(ERR_INVALID_SYMBOL, lineNo, colNo);
 		readChar();
+		return token;
+	default:
+		break;
+	}
+
+	// The remaining tokens end with the current character
+	if (state == ST_START)
+	{
+		ln = lineNo;
+		cn = colNo;
+	}
+	readChar();
+	switch (next)
+	{
+	case AC_PLUS:
+		return makeToken(SB_PLUS, lineNo, colNo - 1);
+	case AC_MINUS:
 		return makeToken(SB_MINUS, lineNo, colNo - 1);
-	case 11:
-		readChar();
+	case AC_TIMES:
 		return makeToken(SB_TIMES, lineNo, colNo - 1);
-	case 12:
-		readChar();
+	case AC_SLASH:
 		return makeToken(SB_SLASH, lineNo, colNo - 1);
-	case 13:
-		readChar();
-		if (charCodes[currentChar] == CHAR_EQ) state = 14; else state = 15;
-		return getToken();
-	case 14:
-		readChar();
+	case AC_LE:
 		return makeToken(SB_LE, lineNo, colNo - 1);
-	case 15:
-		return makeToken(SB_LT, lineNo, colNo - 1);
-	case 16:
-		readChar();
-		if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
-			state = 17;
-		else
-			state = 18;
-		return getToken();
-	case 17:
-		readChar();
+	case AC_GE:
 		return makeToken(SB_GE, lineNo, colNo - 1);
-	case 18:
-		return makeToken(SB_GT, lineNo, colNo - 1);
-	case 19:
-		readChar();
+	case AC_EQ:
 		return makeToken(SB_EQ, lineNo, colNo - 1);
-	case 20:
-		readChar();
-		if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
-			state = 21;
-		else
-			state = 22;
-		return getToken();
-	case 21:
-		readChar();
+	case AC_NEQ:
 		return makeToken(SB_NEQ, lineNo, colNo - 1);
-	case 22:
-		token = makeToken(TK_NONE, lineNo, colNo - 1);
-		error(ERR_INVALID_SYMBOL, token->lineNo, token->colNo);
-		return token;
-	case 23:
-		readChar();
+	case AC_COMMA:
 		return makeToken(SB_COMMA, lineNo, colNo - 1);
-	case 24:
-		readChar();
-		if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_RPAR))
-			state = 25;
-		else
-			state = 26;
-		return getToken();
-	case 25:
-		readChar();
+	case AC_RSEL:
 		return makeToken(SB_RSEL, lineNo, colNo - 1);
-	case 26:
-		readChar();
+	case AC_PERIOD:
+		// The character following the period has just been skipped as well
 		return makeToken(SB_PERIOD, lineNo, colNo - 1);
-	case 27:
-		ln = lineNo;
-		cn = colNo;
-		readChar();
+	case AC_ASSIGN:
+		return makeToken(SB_ASSIGN, lineNo, colNo - 1);
+	case AC_LSEL:
+		return makeToken(SB_LSEL, ln, cn);
+	case AC_SEMICOLON:
 		if (ln != lineNo)
 			return makeToken(SB_SEMICOLON, ln, cn);
-
 		return makeToken(SB_SEMICOLON, lineNo, colNo - 1);
-	case 28:
-		readChar();
-		if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
-			state = 29;
-		else
-			state = 30;
-		return getToken();
-	case 29:
-		readChar();
-		return makeToken(SB_ASSIGN, lineNo, colNo - 1);
-	case 30:
-		return makeToken(SB_COLON, lineNo, colNo - 1);
-	case 31:
-		readChar();
-		if (currentChar == EOF)
-			state = 34;
-		else
-			if (isprint(currentChar))
-				state = 32;
-			else state = 34;
-		return getToken();
-	case 32:
-		c = currentChar;
-		readChar();
-		if (charCodes[currentChar] == CHAR_SINGLEQUOTE)
-			state = 33;
-		else
-			state = 34;
-		return getToken();
-	case 33:
-		token = makeToken(TK_CHAR, lineNo, colNo - 1);
-		token->string[0] = c;
-		token->string[1] = '\0';
-		readChar();
-		return token;
-	case 34:
-		error(ERR_INVALID_CONSTANT, lineNo, colNo - 2);
-	case 35:
-		ln = lineNo;
-		cn = colNo;
-		readChar();
-		if (currentChar == EOF)
-			state = 41;
-		else
-			switch (charCodes[currentChar])
-			{
-			case CHAR_PERIOD:
-				state = 36;
-				break;
-			case CHAR_TIMES:
-				state = 38;
-				break;
-			default:state = 41;
-			}
-		return getToken();
-	case 36:
-		readChar();
-		return makeToken(SB_LSEL, ln, cn);
-	case 37:
-		while ((currentChar != EOF) && (charCodes[currentChar] != CHAR_TIMES))
-		{
-			state = 37;
-			readChar();
-		}
-		if (currentChar == EOF)
-			state = 40;
-		else state = 38;
-		return getToken();
-	case 38:
-		while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_TIMES))
-		{
-			state = 38;
-			readChar();
-		}
-		if (currentChar == EOF)
-			state = 40;
-		else
-			if (charCodes[currentChar] == CHAR_RPAR) state = 39;
-			else state = 37;
-		return getToken();
-	case 39:
-		state = 0;
-		readChar();
-		return getToken();
-	case 40:
-		error(ERR_END_OF_COMMENT, lineNo, colNo);
-	case 41:return makeToken(SB_LPAR, ln, cn);
-	case 42:
-		ln = lineNo;
-		cn = colNo;
-		readChar();
+	case AC_RPAR:
 		if (ln != lineNo)
 			return makeToken(SB_RPAR, ln, cn);
 		return makeToken(SB_RPAR, lineNo, colNo - 1);
-	case 43:
-		token = makeToken(TK_NONE, lineNo, colNo);
-		error(ERR_INVALID_SYMBOL, lineNo, colNo);
-		readChar();
-		return token;
+	default:
+		return makeToken(TK_NONE, lineNo, colNo);
 	}
 }
+
 Token* getValidToken(void) {
-	state = 0;
 	Token* token = getToken();
 	while (token->tokenType == TK_NONE) {
-		free(token);
+		freeToken(token);
 		token = getToken();
 	}
 	return token;
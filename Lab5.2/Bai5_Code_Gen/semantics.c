@@ -20,7 +20,7 @@ Object *lookupObject(char *name)
 
   while (scope != NULL)
   {
-    obj = findObject(scope->objList, name);
+    obj = findScopeObject(scope, name);
     if (obj != NULL)
       return obj;
     scope = scope->outer;
@@ -33,7 +33,7 @@ Object *lookupObject(char *name)
 
 void checkFreshIdent(char *name)
 {
-  if (findObject(symtab->currentScope->objList, name) != NULL)
+  if (findScopeObject(symtab->currentScope, name) != NULL)
     error(ERR_DUPLICATE_IDENT, currentToken->lineNo, currentToken->colNo);
 }
 
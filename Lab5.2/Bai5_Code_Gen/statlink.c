@@ -0,0 +1,96 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "statlink.h"
+#include "subprogram.h"
+
+/******************* Static links ******************************/
+
+// Reaching level frames out from sub follows the static links of sub and
+// of the level - 1 subprograms around it. Returns whether a mark is new.
+int markLinkReads(SubprogramTable *table, char *readsLink, int sub, int level)
+{
+  int changed = 0;
+
+  for (; (level > 0) && (sub >= 0); level--)
+  {
+    changed |= !readsLink[sub];
+    readsLink[sub] = 1;
+    sub = table->subprograms[sub].outer;
+  }
+  return changed;
+}
+
+// Loads from outer frames follow static links. A call follows them only to
+// find the callee's static link, so it counts just when the callee reads
+// its own: marks spread through the calls until nothing changes.
+void findLinkReads(SubprogramTable *table, char *readsLink)
+{
+  Instruction *code = table->codeBlock->code;
+  Subprogram *sub;
+  CodeAddress i;
+  int k, callee, changed;
+
+  do
+  {
+    changed = 0;
+    for (k = 0; k < table->count; k++)
+    {
+      sub = table->subprograms + k;
+      for (i = sub->entry + 1; i < sub->exit; i++)
+      {
+        if (code[i].p <= 0)
+          continue;
+        switch (code[i].op)
+        {
+        case OP_LA:
+        case OP_LV:
+        case OP_CALL:
+          break;
+        case OP_ENTER:
+          callee = calleeAt(table, code + i);
+          if ((callee >= 0) && !readsLink[callee])
+            continue;
+          break;
+        default:
+          continue;
+        }
+        changed |= markLinkReads(table, readsLink, k, code[i].p);
+      }
+    }
+  } while (changed);
+}
+
+int elideStaticLinks(CodeBlock *codeBlock, Object *program)
+{
+  Instruction *code = codeBlock->code;
+  SubprogramTable *table = buildSubprogramTable(codeBlock, program);
+  char *readsLink = (char *)calloc(table->count, sizeof(char));
+  int count = 0;
+  int callee;
+  CodeAddress i;
+
+  findLinkReads(table, readsLink);
+
+  // The program is never entered by a call, so index 0 is left alone
+  for (i = 0; i < codeBlock->codeSize; i++)
+  {
+    if (code[i].op != OP_ENTER)
+      continue;
+    callee = calleeAt(table, code + i);
+    if ((callee > 0) && !readsLink[callee])
+    {
+      code[i].op = OP_ENTERL;
+      code[i].p = DC_VALUE;
+      count++;
+    }
+  }
+
+  free(readsLink);
+  freeSubprogramTable(table);
+  return count;
+}
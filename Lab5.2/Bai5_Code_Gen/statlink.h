@@ -0,0 +1,19 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __STATLINK_H__
+#define __STATLINK_H__
+
+#include "symtab.h"
+#include "instructions.h"
+
+// Turns each ENTER to a subprogram whose static link is never followed into
+// an ENTERL, which does not compute it. Inlining goes first, as it takes
+// away many of the outer-frame accesses. Returns the number of calls changed.
+
+int elideStaticLinks(CodeBlock* codeBlock, Object* program);
+
+#endif
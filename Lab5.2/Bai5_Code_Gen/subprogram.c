@@ -0,0 +1,96 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "subprogram.h"
+
+int addSubprogram(SubprogramTable *table, Object *owner, CodeAddress entry, Scope *scope, int outer, int isFunction, int paramCount)
+{
+  Instruction *code = table->codeBlock->code;
+  int codeSize = table->codeBlock->codeSize;
+  Subprogram *sub;
+  CodeAddress exit;
+
+  if (table->count == table->maxCount)
+  {
+    table->maxCount *= 2;
+    table->subprograms = (Subprogram *)realloc(table->subprograms, table->maxCount * sizeof(Subprogram));
+  }
+
+  exit = entry + 1;
+  while ((exit < codeSize) && (code[exit].op != OP_EP) && (code[exit].op != OP_EF) && (code[exit].op != OP_HL))
+    exit++;
+
+  sub = table->subprograms + table->count;
+  sub->owner = owner;
+  sub->entry = entry;
+  sub->exit = exit;
+  sub->depth = scope->depth;
+  sub->outer = outer;
+  sub->isFunction = isFunction;
+  sub->paramCount = paramCount;
+  sub->frameSize = code[entry].q;
+  table->subprogramAt[entry] = table->count;
+  return table->count++;
+}
+
+void collectSubprograms(SubprogramTable *table, Scope *scope, int outer)
+{
+  ObjectNode *node;
+  Object *obj;
+  int sub;
+
+  for (node = scope->objList; node != NULL; node = node->next)
+  {
+    obj = node->object;
+    if (obj->kind == OBJ_FUNCTION)
+    {
+      sub = addSubprogram(table, obj, obj->funcAttrs->codeAddress, obj->funcAttrs->scope, outer, 1, obj->funcAttrs->paramCount);
+      collectSubprograms(table, obj->funcAttrs->scope, sub);
+    }
+    else if (obj->kind == OBJ_PROCEDURE)
+    {
+      sub = addSubprogram(table, obj, obj->procAttrs->codeAddress, obj->procAttrs->scope, outer, 0, obj->procAttrs->paramCount);
+      collectSubprograms(table, obj->procAttrs->scope, sub);
+    }
+  }
+}
+
+SubprogramTable *buildSubprogramTable(CodeBlock *codeBlock, Object *program)
+{
+  SubprogramTable *table = (SubprogramTable *)malloc(sizeof(SubprogramTable));
+  CodeAddress entry = program->progAttrs->codeAddress;
+  int i;
+
+  table->codeBlock = codeBlock;
+  table->count = 0;
+  table->maxCount = 16;
+  table->subprograms = (Subprogram *)malloc(table->maxCount * sizeof(Subprogram));
+  table->subprogramAt = (int *)malloc((codeBlock->codeSize + 1) * sizeof(int));
+  for (i = 0; i <= codeBlock->codeSize; i++)
+    table->subprogramAt[i] = -1;
+
+  // The program's code starts with a jump over its subprograms, if it has any
+  if (codeBlock->code[entry].op == OP_J)
+    entry = codeBlock->code[entry].q;
+  addSubprogram(table, program, entry, program->progAttrs->scope, -1, 0, 0);
+  collectSubprograms(table, program->progAttrs->scope, 0);
+  return table;
+}
+
+void freeSubprogramTable(SubprogramTable *table)
+{
+  free(table->subprograms);
+  free(table->subprogramAt);
+  free(table);
+}
+
+int calleeAt(SubprogramTable *table, Instruction *inst)
+{
+  if (((inst->op != OP_ENTER) && (inst->op != OP_ENTERL)) || (inst->q < 0) || (inst->q >= table->codeBlock->codeSize))
+    return -1;
+  return table->subprogramAt[inst->q];
+}
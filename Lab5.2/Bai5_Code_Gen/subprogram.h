@@ -0,0 +1,49 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SUBPROGRAM_H__
+#define __SUBPROGRAM_H__
+
+#include "symtab.h"
+#include "instructions.h"
+
+// The subprograms of a parsed program, found through the symbol table, with
+// the code each one runs once its frame is set up. The passes over whole
+// subprograms build it afresh whenever the code may have moved.
+
+// The code of a subprogram, or of the program itself, from its frame setup
+// to its exit. Nested subprograms come before the frame setup, so these
+// ranges never overlap.
+struct Subprogram_ {
+  Object* owner;
+  CodeAddress entry;        // the INT setting up its frame
+  CodeAddress exit;         // its EP or EF, HL for the program
+  int depth;                // static nesting depth of its scope
+  int outer;                // the subprogram its scope is nested in, -1 for the program
+  int isFunction;
+  int paramCount;
+  int frameSize;
+};
+
+typedef struct Subprogram_ Subprogram;
+
+struct SubprogramTable_ {
+  CodeBlock* codeBlock;
+  Subprogram* subprograms;  // the program comes first
+  int count;
+  int maxCount;
+  int* subprogramAt;        // subprogram whose frame setup is at each address, else -1
+};
+
+typedef struct SubprogramTable_ SubprogramTable;
+
+SubprogramTable* buildSubprogramTable(CodeBlock* codeBlock, Object* program);
+void freeSubprogramTable(SubprogramTable* table);
+
+// The subprogram an ENTER or ENTERL enters, else -1
+int calleeAt(SubprogramTable* table, Instruction* inst);
+
+#endif
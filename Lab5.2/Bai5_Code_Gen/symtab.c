@@ -10,11 +10,11 @@
 #include "symtab.h"
 #include "error.h"
 #include "codegen.h"
+#include "intern.h"
+#include "arena.h"
 
-void freeObject(Object *obj);
-void freeScope(Scope *scope);
-void freeObjectList(ObjectNode *objList);
-void freeReferenceList(ObjectNode *objList);
+// Everything in the symbol table lives until cleanSymTab
+Arena symtabArena;
 
 SymTab *symtab;
 Type *intType;
@@ -27,72 +27,93 @@ Object *readcFunction;
 
 /******************* Type utilities ******************************/
 
-Type *makeIntType(void)
+// Types are hash-consed: structurally equal types share one immutable node,
+// so type equality is pointer equality. intType and charType are the only
+// basic types; array types are canonicalized through arrayTypes.
+
+#define INITIAL_TYPE_TABLE_SIZE 16
+
+Type **arrayTypes;              // open addressing, NULL marks an empty slot
+int arrayTypeTableSize;
+int arrayTypeCount;
+
+Type *newType(enum TypeClass typeClass, int arraySize, Type *elementType)
 {
-  Type *type = (Type *)malloc(sizeof(Type));
-  type->typeClass = TP_INT;
+  Type *type = (Type *)arenaAlloc(&symtabArena, sizeof(Type));
+  type->typeClass = typeClass;
+  type->arraySize = arraySize;
+  type->elementType = elementType;
   return type;
 }
 
-Type *makeCharType(void)
+int hashArrayType(int arraySize, Type *elementType, int tableSize)
 {
-  Type *type = (Type *)malloc(sizeof(Type));
-  type->typeClass = TP_CHAR;
-  return type;
+  unsigned h = (unsigned)arraySize * 2654435761u + (unsigned)((unsigned long)elementType >> 3) * 2246822519u;
+  return (int)((h ^ (h >> 15)) & (unsigned)(tableSize - 1));
 }
 
-Type *makeArrayType(int arraySize, Type *elementType)
+void insertArrayType(Type **table, int tableSize, Type *type)
 {
-  Type *type = (Type *)malloc(sizeof(Type));
-  type->typeClass = TP_ARRAY;
-  type->arraySize = arraySize;
-  type->elementType = elementType;
-  return type;
+  int i = hashArrayType(type->arraySize, type->elementType, tableSize);
+
+  while (table[i] != NULL)
+    i = (i + 1) & (tableSize - 1);
+  table[i] = type;
 }
 
-Type *duplicateType(Type *type)
+void growTypeTable(void)
 {
-  Type *resultType = (Type *)malloc(sizeof(Type));
-  resultType->typeClass = type->typeClass;
-  if (type->typeClass == TP_ARRAY)
-  {
-    resultType->arraySize = type->arraySize;
-    resultType->elementType = duplicateType(type->elementType);
-  }
-  return resultType;
+  int size = (arrayTypeTableSize == 0) ? INITIAL_TYPE_TABLE_SIZE : arrayTypeTableSize * 2;
+  Type **table = (Type **)arenaAlloc(&symtabArena, size * sizeof(Type *));
+  int i;
+
+  memset(table, 0, size * sizeof(Type *));
+  for (i = 0; i < arrayTypeTableSize; i++)
+    if (arrayTypes[i] != NULL)
+      insertArrayType(table, size, arrayTypes[i]);
+  arrayTypes = table;
+  arrayTypeTableSize = size;
 }
 
-int compareType(Type *type1, Type *type2)
+Type *makeIntType(void)
 {
-  if (type1->typeClass == type2->typeClass)
+  return intType;
+}
+
+Type *makeCharType(void)
+{
+  return charType;
+}
+
+Type *makeArrayType(int arraySize, Type *elementType)
+{
+  Type *type;
+  int i;
+
+  if (arrayTypeTableSize != 0)
   {
-    if (type1->typeClass == TP_ARRAY)
+    i = hashArrayType(arraySize, elementType, arrayTypeTableSize);
+    while (arrayTypes[i] != NULL)
     {
-      if (type1->arraySize == type2->arraySize)
-        return compareType(type1->elementType, type2->elementType);
-      else
-        return 0;
+      // The element type is canonical too, so one pointer compare covers it
+      if ((arrayTypes[i]->arraySize == arraySize) && (arrayTypes[i]->elementType == elementType))
+        return arrayTypes[i];
+      i = (i + 1) & (arrayTypeTableSize - 1);
     }
-    else
-      return 1;
   }
-  else
-    return 0;
+
+  type = newType(TP_ARRAY, arraySize, elementType);
+  arrayTypeCount++;
+  // Keep the load factor under one half
+  if (arrayTypeCount * 2 > arrayTypeTableSize)
+    growTypeTable();
+  insertArrayType(arrayTypes, arrayTypeTableSize, type);
+  return type;
 }
 
-void freeType(Type *type)
+int compareType(Type *type1, Type *type2)
 {
-  switch (type->typeClass)
-  {
-  case TP_INT:
-  case TP_CHAR:
-    free(type);
-    break;
-  case TP_ARRAY:
-    freeType(type->elementType);
-    freeType(type);
-    break;
-  }
+  return type1 == type2;
 }
 
 int sizeOfType(Type *type)
@@ -113,7 +134,7 @@ int sizeOfType(Type *type)
 
 ConstantValue *makeIntConstant(int i)
 {
-  ConstantValue *value = (ConstantValue *)malloc(sizeof(ConstantValue));
+  ConstantValue *value = (ConstantValue *)arenaAlloc(&symtabArena, sizeof(ConstantValue));
   value->type = TP_INT;
   value->intValue = i;
   return value;
@@ -121,7 +142,7 @@ ConstantValue *makeIntConstant(int i)
 
 ConstantValue *makeCharConstant(char ch)
 {
-  ConstantValue *value = (ConstantValue *)malloc(sizeof(ConstantValue));
+  ConstantValue *value = (ConstantValue *)arenaAlloc(&symtabArena, sizeof(ConstantValue));
   value->type = TP_CHAR;
   value->charValue = ch;
   return value;
@@ -129,7 +150,7 @@ ConstantValue *makeCharConstant(char ch)
 
 ConstantValue *duplicateConstantValue(ConstantValue *v)
 {
-  ConstantValue *value = (ConstantValue *)malloc(sizeof(ConstantValue));
+  ConstantValue *value = (ConstantValue *)arenaAlloc(&symtabArena, sizeof(ConstantValue));
   value->type = v->type;
   if (v->type == TP_INT)
     value->intValue = v->intValue;
@@ -142,20 +163,26 @@ ConstantValue *duplicateConstantValue(ConstantValue *v)
 
 Scope *createScope(Object *owner)
 {
-  Scope *scope = (Scope *)malloc(sizeof(Scope));
+  Scope *scope = (Scope *)arenaAlloc(&symtabArena, sizeof(Scope));
   scope->objList = NULL;
+  scope->lastNode = NULL;
+  scope->index = NULL;
+  scope->indexSize = 0;
+  scope->objCount = 0;
   scope->owner = owner;
   scope->outer = NULL;
+  scope->depth = 0;
   scope->frameSize = RESERVED_WORDS;
+  scope->maxFrameSize = RESERVED_WORDS;
   return scope;
 }
 
 Object *createProgramObject(char *programName)
 {
-  Object *program = (Object *)malloc(sizeof(Object));
-  strcpy(program->name, programName);
+  Object *program = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  program->name = programName;
   program->kind = OBJ_PROGRAM;
-  program->progAttrs = (ProgramAttributes *)malloc(sizeof(ProgramAttributes));
+  program->progAttrs = (ProgramAttributes *)arenaAlloc(&symtabArena, sizeof(ProgramAttributes));
   program->progAttrs->scope = createScope(program);
   program->progAttrs->codeAddress = DC_VALUE;
   symtab->program = program;
@@ -165,28 +192,28 @@ Object *createProgramObject(char *programName)
 
 Object *createConstantObject(char *name)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_CONSTANT;
-  obj->constAttrs = (ConstantAttributes *)malloc(sizeof(ConstantAttributes));
+  obj->constAttrs = (ConstantAttributes *)arenaAlloc(&symtabArena, sizeof(ConstantAttributes));
   return obj;
 }
 
 Object *createTypeObject(char *name)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_TYPE;
-  obj->typeAttrs = (TypeAttributes *)malloc(sizeof(TypeAttributes));
+  obj->typeAttrs = (TypeAttributes *)arenaAlloc(&symtabArena, sizeof(TypeAttributes));
   return obj;
 }
 
 Object *createVariableObject(char *name)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_VARIABLE;
-  obj->varAttrs = (VariableAttributes *)malloc(sizeof(VariableAttributes));
+  obj->varAttrs = (VariableAttributes *)arenaAlloc(&symtabArena, sizeof(VariableAttributes));
   obj->varAttrs->type = NULL;
   obj->varAttrs->scope = NULL;
   obj->varAttrs->localOffset = 0;
@@ -195,10 +222,10 @@ Object *createVariableObject(char *name)
 
 Object *createFunctionObject(char *name)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_FUNCTION;
-  obj->funcAttrs = (FunctionAttributes *)malloc(sizeof(FunctionAttributes));
+  obj->funcAttrs = (FunctionAttributes *)arenaAlloc(&symtabArena, sizeof(FunctionAttributes));
   obj->funcAttrs->returnType = NULL;
   obj->funcAttrs->paramList = NULL;
   obj->funcAttrs->paramCount = 0;
@@ -209,10 +236,10 @@ Object *createFunctionObject(char *name)
 
 Object *createProcedureObject(char *name)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_PROCEDURE;
-  obj->procAttrs = (ProcedureAttributes *)malloc(sizeof(ProcedureAttributes));
+  obj->procAttrs = (ProcedureAttributes *)arenaAlloc(&symtabArena, sizeof(ProcedureAttributes));
   obj->procAttrs->paramList = NULL;
   obj->procAttrs->paramCount = 0;
   obj->procAttrs->codeAddress = DC_VALUE;
@@ -222,10 +249,10 @@ Object *createProcedureObject(char *name)
 
 Object *createParameterObject(char *name, enum ParamKind kind)
 {
-  Object *obj = (Object *)malloc(sizeof(Object));
-  strcpy(obj->name, name);
+  Object *obj = (Object *)arenaAlloc(&symtabArena, sizeof(Object));
+  obj->name = name;
   obj->kind = OBJ_PARAMETER;
-  obj->paramAttrs = (ParameterAttributes *)malloc(sizeof(ParameterAttributes));
+  obj->paramAttrs = (ParameterAttributes *)arenaAlloc(&symtabArena, sizeof(ParameterAttributes));
   obj->paramAttrs->kind = kind;
   obj->paramAttrs->type = NULL;
   obj->paramAttrs->scope = NULL;
@@ -233,99 +260,100 @@ Object *createParameterObject(char *name, enum ParamKind kind)
   return obj;
 }
 
-void freeObject(Object *obj)
+void addObject(ObjectNode **objList, Object *obj)
+{
+  ObjectNode *node = (ObjectNode *)arenaAlloc(&symtabArena, sizeof(ObjectNode));
+  node->object = obj;
+  node->next = NULL;
+  if ((*objList) == NULL)
+    *objList = node;
+  else
+  {
+    ObjectNode *n = *objList;
+    while (n->next != NULL)
+      n = n->next;
+    n->next = node;
+  }
+}
+
+Object *findObject(ObjectNode *objList, char *name)
 {
-  switch (obj->kind)
+  while (objList != NULL)
   {
-  case OBJ_CONSTANT:
-    free(obj->constAttrs->value);
-    free(obj->constAttrs);
-    break;
-  case OBJ_TYPE:
-    free(obj->typeAttrs->actualType);
-    free(obj->typeAttrs);
-    break;
-  case OBJ_VARIABLE:
-    free(obj->varAttrs->type);
-    free(obj->varAttrs);
-    break;
-  case OBJ_FUNCTION:
-    freeReferenceList(obj->funcAttrs->paramList);
-    freeType(obj->funcAttrs->returnType);
-    freeScope(obj->funcAttrs->scope);
-    free(obj->funcAttrs);
-    break;
-  case OBJ_PROCEDURE:
-    freeReferenceList(obj->procAttrs->paramList);
-    freeScope(obj->procAttrs->scope);
-    free(obj->procAttrs);
-    break;
-  case OBJ_PROGRAM:
-    freeScope(obj->progAttrs->scope);
-    free(obj->progAttrs);
-    break;
-  case OBJ_PARAMETER:
-    freeType(obj->paramAttrs->type);
-    free(obj->paramAttrs);
+    if (objList->object->name == name)
+      return objList->object;
+    else
+      objList = objList->next;
   }
-  free(obj);
+  return NULL;
 }
 
-void freeScope(Scope *scope)
+/******************* Scope index ******************************/
+
+#define INITIAL_INDEX_SIZE 8
+
+// Names are interned, so the pointer itself is a good hash key
+int hashName(char *name, int indexSize)
 {
-  freeObjectList(scope->objList);
-  free(scope);
+  return (int)((((unsigned long)name >> 3) * 2654435761u) & (indexSize - 1));
 }
 
-void freeObjectList(ObjectNode *objList)
+void insertIndex(Object **index, int indexSize, Object *obj)
 {
-  ObjectNode *list = objList;
+  int i = hashName(obj->name, indexSize);
 
-  while (list != NULL)
-  {
-    ObjectNode *node = list;
-    list = list->next;
-    freeObject(node->object);
-    free(node);
-  }
+  while (index[i] != NULL)
+    i = (i + 1) & (indexSize - 1);
+  index[i] = obj;
 }
 
-void freeReferenceList(ObjectNode *objList)
+void growIndex(Scope *scope)
 {
-  ObjectNode *list = objList;
+  int size = (scope->indexSize == 0) ? INITIAL_INDEX_SIZE : scope->indexSize * 2;
+  Object **index = (Object **)arenaAlloc(&symtabArena, size * sizeof(Object *));
+  ObjectNode *node;
 
-  while (list != NULL)
-  {
-    ObjectNode *node = list;
-    list = list->next;
-    free(node);
-  }
+  memset(index, 0, size * sizeof(Object *));
+
+  // Reinserting in declaration order keeps the first of two equal names in front
+  for (node = scope->objList; node != NULL; node = node->next)
+    insertIndex(index, size, node->object);
+  scope->index = index;
+  scope->indexSize = size;
 }
 
-void addObject(ObjectNode **objList, Object *obj)
+void addScopeObject(Scope *scope, Object *obj)
 {
-  ObjectNode *node = (ObjectNode *)malloc(sizeof(ObjectNode));
+  ObjectNode *node = (ObjectNode *)arenaAlloc(&symtabArena, sizeof(ObjectNode));
   node->object = obj;
   node->next = NULL;
-  if ((*objList) == NULL)
-    *objList = node;
+  if (scope->lastNode == NULL)
+    scope->objList = node;
   else
-  {
-    ObjectNode *n = *objList;
-    while (n->next != NULL)
-      n = n->next;
-    n->next = node;
-  }
+    scope->lastNode->next = node;
+  scope->lastNode = node;
+  scope->objCount++;
+
+  // Keep the load factor under one half
+  if (scope->objCount * 2 > scope->indexSize)
+    growIndex(scope);
+  else
+    insertIndex(scope->index, scope->indexSize, obj);
 }
 
-Object *findObject(ObjectNode *objList, char *name)
+Object *findScopeObject(Scope *scope, char *name)
 {
-  while (objList != NULL)
+  int i;
+
+  if (scope->indexSize == 0)
+    return NULL;
+
+  i = hashName(name, scope->indexSize);
+  while (scope->index[i] != NULL)
   {
-    if (strcasecmp(objList->object->name, name) == 0)
-      return objList->object;
-    else
-      objList = objList->next;
+    if (scope->index[i]->name == name)
+      return scope->index[i];
+    i = (i + 1) & (scope->indexSize - 1);
   }
   return NULL;
 }
@@ -337,43 +365,50 @@ void initSymTab(void)
   Object *obj;
   Object *param;
 
-  symtab = (SymTab *)malloc(sizeof(SymTab));
+  initArena(&symtabArena);
+  symtab = (SymTab *)arenaAlloc(&symtabArena, sizeof(SymTab));
+
+  intType = newType(TP_INT, 0, NULL);
+  charType = newType(TP_CHAR, 0, NULL);
+  arrayTypes = NULL;
+  arrayTypeTableSize = 0;
+  arrayTypeCount = 0;
+
   symtab->globalObjectList = NULL;
 
-  obj = createFunctionObject("READC");
+  obj = createFunctionObject(internIdent("READC"));
+  readcFunction = obj;
   obj->funcAttrs->returnType = makeCharType();
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createFunctionObject("READI");
+  obj = createFunctionObject(internIdent("READI"));
+  readiFunction = obj;
   obj->funcAttrs->returnType = makeIntType();
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITEI");
-  param = createParameterObject("i", PARAM_VALUE);
+  obj = createProcedureObject(internIdent("WRITEI"));
+  writeiProcedure = obj;
+  param = createParameterObject(internIdent("i"), PARAM_VALUE);
   param->paramAttrs->type = makeIntType();
   addObject(&(obj->procAttrs->paramList), param);
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITEC");
-  param = createParameterObject("ch", PARAM_VALUE);
+  obj = createProcedureObject(internIdent("WRITEC"));
+  writecProcedure = obj;
+  param = createParameterObject(internIdent("ch"), PARAM_VALUE);
   param->paramAttrs->type = makeCharType();
   addObject(&(obj->procAttrs->paramList), param);
   addObject(&(symtab->globalObjectList), obj);
 
-  obj = createProcedureObject("WRITELN");
+  obj = createProcedureObject(internIdent("WRITELN"));
+  writelnProcedure = obj;
   addObject(&(symtab->globalObjectList), obj);
-
-  intType = makeIntType();
-  charType = makeCharType();
 }
 
 void cleanSymTab(void)
 {
-  freeObject(symtab->program);
-  freeObjectList(symtab->globalObjectList);
-  free(symtab);
-  freeType(intType);
-  freeType(charType);
+  freeArena(&symtabArena);
+  symtab = NULL;
 }
 
 void enterBlock(Scope *scope)
@@ -422,13 +457,15 @@ void declareObject(Object *obj)
       break;
     case OBJ_FUNCTION:
       obj->funcAttrs->scope->outer = symtab->currentScope;
+      obj->funcAttrs->scope->depth = symtab->currentScope->depth + 1;
       break;
     case OBJ_PROCEDURE:
       obj->procAttrs->scope->outer = symtab->currentScope;
+      obj->procAttrs->scope->depth = symtab->currentScope->depth + 1;
       break;
     default:
       break;
     }
-    addObject(&(symtab->currentScope->objList), obj);
+    addScopeObject(symtab->currentScope, obj);
   }
 }
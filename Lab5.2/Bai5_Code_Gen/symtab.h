@@ -109,7 +109,7 @@ typedef struct ProgramAttributes_ ProgramAttributes;
 typedef struct ParameterAttributes_ ParameterAttributes;
 
 struct Object_ {
-  char name[MAX_IDENT_LEN];
+  char *name;             // interned, see intern.h
   enum ObjectKind kind;
   union {
     ConstantAttributes* constAttrs;
@@ -132,10 +132,16 @@ struct ObjectNode_ {
 typedef struct ObjectNode_ ObjectNode;
 
 struct Scope_ {
-  ObjectNode *objList;
+  ObjectNode *objList;    // declaration order
+  ObjectNode *lastNode;
+  Object **index;         // open addressing on the interned name, NULL marks an empty slot
+  int indexSize;          // 0 or a power of two
+  int objCount;
   Object *owner;
   struct Scope_ *outer;
+  int depth;              // static nesting depth, 0 for the program
   int frameSize;
+  int maxFrameSize;       // the most frameSize reached, hidden slots of closed FOR loops included
 };
 
 typedef struct Scope_ Scope;
@@ -151,9 +157,7 @@ typedef struct SymTab_ SymTab;
 Type* makeIntType(void);
 Type* makeCharType(void);
 Type* makeArrayType(int arraySize, Type* elementType);
-Type* duplicateType(Type* type);
 int compareType(Type* type1, Type* type2);
-void freeType(Type* type);
 int sizeOfType(Type* type);
 
 ConstantValue* makeIntConstant(int i);
@@ -171,6 +175,7 @@ Object* createProcedureObject(char *name);
 Object* createParameterObject(char *name, enum ParamKind kind);
 
 Object* findObject(ObjectNode *objList, char *name);
+Object* findScopeObject(Scope* scope, char *name);
 
 void initSymTab(void);
 void cleanSymTab(void);
@@ -4,8 +4,9 @@
  * @version 1.0
  */
 
+#include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <string.h>
 #include "token.h"
 
 struct
@@ -34,36 +35,107 @@ struct
     {"FOR", KW_FOR},
     {"TO", KW_TO}};
 
-int keywordEq(char *kw, char *string)
+// Perfect hash over keywords[]:
+//   hash = (3 * length + upper(s[0]) + upper(s[1])) mod KEYWORD_HASH_SIZE
+// keywordSlots[hash] is the index of the only keyword with that hash, or -1.
+// The table is built from keywords[] on the first lookup, which stops the
+// compiler if an edit to keywords[] or to the hash makes two keywords meet.
+#define KEYWORD_HASH_SIZE 64
+
+// Folds letters to upper case; digits fold to values no keyword letter has
+#define FOLD(c) ((c) & 0xDF)
+#define KEYWORD_HASH(s, length) ((3 * (length) + FOLD((s)[0]) + FOLD((s)[1])) & (KEYWORD_HASH_SIZE - 1))
+
+signed char keywordSlots[KEYWORD_HASH_SIZE];
+int maxKeywordLength = -1;  // -1 until keywordSlots is built
+
+void buildKeywordSlots(void)
 {
-  while ((*kw != '\0') && (*string != '\0'))
+  int i, length, hash;
+
+  for (hash = 0; hash < KEYWORD_HASH_SIZE; hash++)
+    keywordSlots[hash] = -1;
+
+  maxKeywordLength = 0;
+  for (i = 0; i < KEYWORDS_COUNT; i++)
   {
-    if (toupper(*kw) != toupper(*string))
-      break;
-    kw++;
-    string++;
+    length = strlen(keywords[i].string);
+    hash = KEYWORD_HASH(keywords[i].string, length);
+    if ((length < 2) || (keywordSlots[hash] >= 0))
+    {
+      printf("Keyword %s has no slot of its own in the keyword hash\n", keywords[i].string);
+      exit(-1);
+    }
+    keywordSlots[hash] = i;
+    if (length > maxKeywordLength)
+      maxKeywordLength = length;
   }
-  return ((*kw == '\0') && (*string == '\0'));
 }
 
 TokenType checkKeyword(char *string)
 {
-  int i;
-  for (i = 0; i < KEYWORDS_COUNT; i++)
-    if (keywordEq(keywords[i].string, string))
-      return keywords[i].tokenType;
-  return TK_NONE;
+  int length = 0;
+  int slot;
+  char *kw;
+
+  if (maxKeywordLength < 0)
+    buildKeywordSlots();
+
+  while (string[length] != '\0')
+    if (++length > maxKeywordLength)
+      return TK_NONE;
+  if (length < 2)
+    return TK_NONE;
+
+  slot = keywordSlots[KEYWORD_HASH(string, length)];
+  if (slot < 0)
+    return TK_NONE;
+
+  // A single candidate: compare it including its terminator
+  kw = keywords[slot].string;
+  while (length-- > 0)
+    if (FOLD(*string++) != *kw++)
+      return TK_NONE;
+  return (*kw == '\0') ? keywords[slot].tokenType : TK_NONE;
 }
 
+/******************* Token pool ******************************/
+
+Token tokenPool[TOKEN_POOL_SIZE];
+Token *freeTokens[TOKEN_POOL_SIZE];
+int freeTokenCount = -1;
+
 Token *makeToken(TokenType tokenType, int lineNo, int colNo)
 {
-  Token *token = (Token *)malloc(sizeof(Token));
+  Token *token;
+
+  if (freeTokenCount < 0)
+  {
+    for (freeTokenCount = 0; freeTokenCount < TOKEN_POOL_SIZE; freeTokenCount++)
+      freeTokens[freeTokenCount] = tokenPool + freeTokenCount;
+  }
+
+  // Only a caller keeping more tokens alive than the pool holds reaches malloc
+  if (freeTokenCount > 0)
+    token = freeTokens[--freeTokenCount];
+  else
+    token = (Token *)malloc(sizeof(Token));
   token->tokenType = tokenType;
   token->lineNo = lineNo;
   token->colNo = colNo;
   return token;
 }
 
+void freeToken(Token *token)
+{
+  if (token == NULL)
+    return;
+  if ((token >= tokenPool) && (token < tokenPool + TOKEN_POOL_SIZE))
+    freeTokens[freeTokenCount++] = token;
+  else
+    free(token);
+}
+
 char *tokenToString(TokenType tokenType)
 {
   switch (tokenType)
@@ -10,6 +10,9 @@
 #define MAX_IDENT_LEN 15
 #define KEYWORDS_COUNT 20
 
+// The parser holds currentToken and lookAhead while the scanner builds the next one
+#define TOKEN_POOL_SIZE 4
+
 typedef enum {
   TK_NONE, TK_IDENT, TK_NUMBER, TK_CHAR, TK_EOF,
 
@@ -28,6 +31,7 @@ typedef enum {
 
 typedef struct {
   char string[MAX_IDENT_LEN + 1];
+  char *ident;            // interned name of a TK_IDENT token
   int lineNo, colNo;
   TokenType tokenType;
   int value;
@@ -35,6 +39,7 @@ typedef struct {
 
 TokenType checkKeyword(char *string);
 Token* makeToken(TokenType tokenType, int lineNo, int colNo);
+void freeToken(Token* token);
 char *tokenToString(TokenType tokenType);
 
 
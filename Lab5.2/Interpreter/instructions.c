@@ -0,0 +1,202 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "instructions.h"
+
+#define MAX_BLOCK 50
+
+CodeBlock* createCodeBlock(int maxSize) {
+  CodeBlock* codeBlock = (CodeBlock*) malloc(sizeof(CodeBlock));
+
+  codeBlock->code = (Instruction*) malloc(maxSize * sizeof(Instruction));
+  codeBlock->codeSize = 0;
+  codeBlock->maxSize = maxSize;
+  return codeBlock;
+}
+
+void freeCodeBlock(CodeBlock* codeBlock) {
+  free(codeBlock->code);
+  free(codeBlock);
+}
+
+// Doubling keeps the total copying linear in the final code size
+int growCodeBlock(CodeBlock* codeBlock) {
+  int maxSize = (codeBlock->maxSize > 0) ? codeBlock->maxSize * 2 : MAX_BLOCK;
+  Instruction* code = (Instruction*) realloc(codeBlock->code, maxSize * sizeof(Instruction));
+
+  if (code == NULL) return 0;
+  codeBlock->code = code;
+  codeBlock->maxSize = maxSize;
+  return 1;
+}
+
+int emitCode(CodeBlock* codeBlock, enum OpCode op, WORD p, WORD q) {
+  Instruction* bottom;
+
+  if ((codeBlock->codeSize >= codeBlock->maxSize) && !growCodeBlock(codeBlock))
+    return 0;
+
+  bottom = codeBlock->code + codeBlock->codeSize;
+  bottom->op = op;
+  bottom->p = p;
+  bottom->q = q;
+  codeBlock->codeSize ++;
+  return 1;
+}
+
+int emitLA(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_LA, p, q); }
+int emitLV(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_LV, p, q); }
+int emitLC(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_LC, DC_VALUE, q); }
+int emitLI(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_LI, DC_VALUE, DC_VALUE); }
+int emitINT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_INT, DC_VALUE, q); }
+int emitDCT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_DCT, DC_VALUE, q); }
+int emitJ(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_J, DC_VALUE, q); }
+int emitFJ(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_FJ, DC_VALUE, q); }
+int emitHL(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_HL, DC_VALUE, DC_VALUE); }
+int emitST(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_ST, DC_VALUE, DC_VALUE); }
+int emitCALL(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_CALL, p, q); }
+int emitEP(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_EP, DC_VALUE, DC_VALUE); }
+int emitEF(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_EF, DC_VALUE, DC_VALUE); }
+int emitRC(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_RC, DC_VALUE, DC_VALUE); }
+int emitRI(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_RI, DC_VALUE, DC_VALUE); }
+int emitWRC(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_WRC, DC_VALUE, DC_VALUE); }
+int emitWRI(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_WRI, DC_VALUE, DC_VALUE); }
+int emitWLN(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_WLN, DC_VALUE, DC_VALUE); }
+int emitAD(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_AD, DC_VALUE, DC_VALUE); }
+int emitSB(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_SB, DC_VALUE, DC_VALUE); }
+int emitML(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_ML, DC_VALUE, DC_VALUE); }
+int emitDV(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_DV, DC_VALUE, DC_VALUE); }
+int emitNEG(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_NEG, DC_VALUE, DC_VALUE); }
+int emitCV(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_CV, DC_VALUE, DC_VALUE); }
+int emitEQ(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_EQ, DC_VALUE, DC_VALUE); }
+int emitNE(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_NE, DC_VALUE, DC_VALUE); }
+int emitGT(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_GT, DC_VALUE, DC_VALUE); }
+int emitLT(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_LT, DC_VALUE, DC_VALUE); }
+int emitGE(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_GE, DC_VALUE, DC_VALUE); }
+int emitLE(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_LE, DC_VALUE, DC_VALUE); }
+int emitJEQ(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JEQ, DC_VALUE, q); }
+int emitJNE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JNE, DC_VALUE, q); }
+int emitJGT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JGT, DC_VALUE, q); }
+int emitJLT(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JLT, DC_VALUE, q); }
+int emitJGE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JGE, DC_VALUE, q); }
+int emitJLE(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_JLE, DC_VALUE, q); }
+int emitENTER(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_ENTER, p, q); }
+int emitINCV(CodeBlock* codeBlock, WORD p, WORD q) { return emitCode(codeBlock, OP_INCV, p, q); }
+int emitENTERL(CodeBlock* codeBlock, WORD q) { return emitCode(codeBlock, OP_ENTERL, DC_VALUE, q); }
+
+int emitBP(CodeBlock* codeBlock) { return emitCode(codeBlock, OP_BP, DC_VALUE, DC_VALUE); }
+
+int isJumpOpCode(enum OpCode op) {
+  return ((op >= OP_JEQ) && (op <= OP_JLE)) || (op == OP_J) || (op == OP_FJ) || (op == OP_CALL) || (op == OP_ENTER) || (op == OP_ENTERL);
+}
+
+// The compare-and-jump taken exactly when the comparison op is true
+enum OpCode compareJump(enum OpCode op) {
+  switch (op) {
+  case OP_EQ: return OP_JEQ;
+  case OP_NE: return OP_JNE;
+  case OP_GT: return OP_JGT;
+  case OP_LT: return OP_JLT;
+  case OP_GE: return OP_JGE;
+  case OP_LE: return OP_JLE;
+  default: return OP_FJ;
+  }
+}
+
+// The compare-and-jump taken exactly when the comparison op is false
+enum OpCode negateCompareJump(enum OpCode op) {
+  switch (op) {
+  case OP_EQ: return OP_JNE;
+  case OP_NE: return OP_JEQ;
+  case OP_GT: return OP_JLE;
+  case OP_LT: return OP_JGE;
+  case OP_GE: return OP_JLT;
+  case OP_LE: return OP_JGT;
+  default: return OP_FJ;
+  }
+}
+
+void printInstruction(Instruction* inst) {
+  switch (inst->op) {
+  case OP_LA: printf("LA %d,%d", inst->p, inst->q); break;
+  case OP_LV: printf("LV %d,%d", inst->p, inst->q); break;
+  case OP_LC: printf("LC %d", inst->q); break;
+  case OP_LI: printf("LI"); break;
+  case OP_INT: printf("INT %d", inst->q); break;
+  case OP_DCT: printf("DCT %d", inst->q); break;
+  case OP_J: printf("J %d", inst->q); break;
+  case OP_FJ: printf("FJ %d", inst->q); break;
+  case OP_HL: printf("HL"); break;
+  case OP_ST: printf("ST"); break;
+  case OP_CALL: printf("CALL %d,%d", inst->p, inst->q); break;
+  case OP_EP: printf("EP"); break;
+  case OP_EF: printf("EF"); break;
+  case OP_RC: printf("RC"); break;
+  case OP_RI: printf("RI"); break;
+  case OP_WRC: printf("WRC"); break;
+  case OP_WRI: printf("WRI"); break;
+  case OP_WLN: printf("WLN"); break;
+  case OP_AD: printf("AD"); break;
+  case OP_SB: printf("SB"); break;
+  case OP_ML: printf("ML"); break;
+  case OP_DV: printf("DV"); break;
+  case OP_NEG: printf("NEG"); break;
+  case OP_CV: printf("CV"); break;
+  case OP_EQ: printf("EQ"); break;
+  case OP_NE: printf("NE"); break;
+  case OP_GT: printf("GT"); break;
+  case OP_LT: printf("LT"); break;
+  case OP_GE: printf("GE"); break;
+  case OP_LE: printf("LE"); break;
+  case OP_JEQ: printf("JEQ %d", inst->q); break;
+  case OP_JNE: printf("JNE %d", inst->q); break;
+  case OP_JGT: printf("JGT %d", inst->q); break;
+  case OP_JLT: printf("JLT %d", inst->q); break;
+  case OP_JGE: printf("JGE %d", inst->q); break;
+  case OP_JLE: printf("JLE %d", inst->q); break;
+  case OP_ENTER: printf("ENTER %d,%d", inst->p, inst->q); break;
+  case OP_INCV: printf("INCV %d,%d", inst->p, inst->q); break;
+  case OP_ENTERL: printf("ENTERL %d", inst->q); break;
+
+  case OP_BP: printf("BP"); break;
+  default: break;
+  }
+}
+
+void printCodeBlock(CodeBlock* codeBlock) {
+  Instruction* pc = codeBlock->code;
+  int i;
+  for (i = 0 ; i < codeBlock->codeSize; i ++) {
+    printf("%d:  ",i);
+    printInstruction(pc);
+    printf("\n");
+    pc ++;
+  }
+}
+
+
+void loadCode(CodeBlock* codeBlock, FILE* f) {
+  int n;
+
+  codeBlock->codeSize = 0;
+  while (!feof(f)) {
+    if ((codeBlock->codeSize >= codeBlock->maxSize) && !growCodeBlock(codeBlock))
+      return;
+    n = codeBlock->maxSize - codeBlock->codeSize;
+    if (n > MAX_BLOCK)
+      n = MAX_BLOCK;
+    n = fread(codeBlock->code + codeBlock->codeSize, sizeof(Instruction), n, f);
+    if (n == 0)
+      break;
+    codeBlock->codeSize += n;
+  }
+}
+
+
+void saveCode(CodeBlock* codeBlock, FILE* f) {
+  fwrite(codeBlock->code, sizeof(Instruction), codeBlock->codeSize, f);
+}
@@ -0,0 +1,114 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vm.h"
+
+int requestedStackSize = DEFAULT_STACK_SIZE;
+int dumpCode = 0;
+int printStat = 0;
+
+void printUsage(void) {
+  printf("Usage: kplrun input [-s=stack-size] [-dump] [-stat]\n");
+  printf("   input: executable produced by kplc\n");
+  printf("   -s=stack-size: stack size in words (default %d)\n", DEFAULT_STACK_SIZE);
+  printf("   -dump: code dump\n");
+  printf("   -stat: print executed instructions and dispatch rate\n");
+}
+
+int analyseParam(char* param) {
+  if (strncmp(param, "-s=", 3) == 0) {
+    requestedStackSize = atoi(param + 3);
+    return requestedStackSize > 0;
+  }
+  if (strcmp(param, "-dump") == 0) {
+    dumpCode = 1;
+    return 1;
+  }
+  if (strcmp(param, "-stat") == 0) {
+    printStat = 1;
+    return 1;
+  }
+  return 0;
+}
+
+char* statusMessage(int status) {
+  switch (status) {
+  case PS_DIVIDE_BY_ZERO: return "Divide by zero.";
+  case PS_STACK_OVERFLOW: return "Stack overflow.";
+  case PS_MEMORY_ERROR: return "Invalid memory access.";
+  case PS_IO_ERROR: return "Input error.";
+  case PS_INVALID_INSTRUCTION: return "Invalid instruction.";
+  default: return "Unknown error.";
+  }
+}
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  FILE* f;
+  int i;
+  int status;
+  clock_t start;
+  double seconds;
+
+  if (argc <= 1) {
+    printf("kplrun: no input file.\n");
+    printUsage();
+    return -1;
+  }
+
+  for (i = 2; i < argc; i ++)
+    if (!analyseParam(argv[i])) {
+      printf("kplrun: invalid option %s\n", argv[i]);
+      printUsage();
+      return -1;
+    }
+
+  f = fopen(argv[1], "rb");
+  if (f == NULL) {
+    printf("Can\'t read input file!\n");
+    return -1;
+  }
+
+  if (!initVM(requestedStackSize)) {
+    fclose(f);
+    printf("Can\'t allocate the stack!\n");
+    return -1;
+  }
+
+  if (!loadExecutable(f)) {
+    fclose(f);
+    cleanVM();
+    printf("Invalid executable!\n");
+    return -1;
+  }
+  fclose(f);
+
+  if (dumpCode)
+    printCodeBlock(getCodeBlock());
+
+  start = clock();
+  status = run();
+  seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+  if (status != PS_DONE)
+    fprintf(stderr, "Runtime error: %s\n", statusMessage(status));
+
+  if (printStat) {
+    fprintf(stderr, "%s dispatch: %lld instructions in %.3f s", getDispatchName(), getInstructionCount(), seconds);
+    if (seconds > 0)
+      fprintf(stderr, " (%.1f M instructions/s)", getInstructionCount() / seconds / 1e6);
+    fprintf(stderr, "\n");
+  }
+
+  cleanVM();
+  return (status == PS_DONE) ? 0 : -1;
+}
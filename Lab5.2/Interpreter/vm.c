@@ -0,0 +1,437 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "vm.h"
+
+CodeBlock* codeBlock = NULL;
+Memory* stack = NULL;
+int stackSize = 0;
+long long instructionCount = 0;
+
+#ifndef VM_SWITCH_DISPATCH
+// Direct-threaded form of the code: every instruction carries the address
+// of its handler, so dispatch is a single indirect jump.
+typedef struct {
+  const void* handler;
+  WORD p;
+  WORD q;
+} ThreadedInstruction;
+
+ThreadedInstruction* threadedCode = NULL;
+#endif
+
+int initVM(int size) {
+  stack = (Memory*) malloc(size * sizeof(Memory));
+  if (stack == NULL)
+    return 0;
+  stackSize = size;
+  return 1;
+}
+
+void cleanVM(void) {
+  free(stack);
+  stack = NULL;
+  if (codeBlock != NULL) {
+    freeCodeBlock(codeBlock);
+    codeBlock = NULL;
+  }
+#ifndef VM_SWITCH_DISPATCH
+  free(threadedCode);
+  threadedCode = NULL;
+#endif
+}
+
+CodeBlock* getCodeBlock(void) {
+  return codeBlock;
+}
+
+long long getInstructionCount(void) {
+  return instructionCount;
+}
+
+const char* getDispatchName(void) {
+#ifdef VM_SWITCH_DISPATCH
+  return "switch";
+#else
+  return "direct-threaded";
+#endif
+}
+
+int loadExecutable(FILE* f) {
+  long size;
+  int count;
+  int i;
+  Instruction* inst;
+
+  if (fseek(f, 0, SEEK_END) != 0)
+    return 0;
+  size = ftell(f);
+  if ((size <= 0) || (size % sizeof(Instruction) != 0))
+    return 0;
+  rewind(f);
+
+  count = size / sizeof(Instruction);
+  // One extra slot for the sentinel halt
+  codeBlock = createCodeBlock(count + 1);
+  loadCode(codeBlock, f);
+  if (codeBlock->codeSize != count)
+    return 0;
+
+  // Falling off the end of the code halts the program
+  emitHL(codeBlock);
+
+  // Validate once, so that the dispatch loop never checks opcodes or jump targets
+  for (i = 0, inst = codeBlock->code; i < codeBlock->codeSize; i ++, inst ++) {
+    if (((unsigned) inst->op) > OP_BP)
+      return 0;
+    if (isJumpOpCode(inst->op) && ((inst->q < 0) || (inst->q >= codeBlock->codeSize)))
+      return 0;
+    // A negative INT or DCT would move t past the check made for it
+    if (((inst->op == OP_INT) || (inst->op == OP_DCT)) && (inst->q < 0))
+      return 0;
+    // ENTER and ENTERL take the frame layout from the INT they enter at
+    if (((inst->op == OP_ENTER) || (inst->op == OP_ENTERL)) && ((codeBlock->code[inst->q].op != OP_INT) || (codeBlock->code[inst->q].p < 0)))
+      return 0;
+  }
+  return 1;
+}
+
+/******************************************************************/
+
+#ifdef VM_SWITCH_DISPATCH
+#define CASE(op) case op:
+#define DISPATCH() continue
+#define NEXT() { ip ++; continue; }
+#else
+#define CASE(op) L_##op:
+#define DISPATCH() { count ++; goto *ip->handler; }
+#define NEXT() { ip ++; DISPATCH(); }
+#endif
+
+#define JUMP(label) { ip = code + (label); DISPATCH(); }
+#define CHECK_STACK(top) if ((top) > limit) goto stackOverflow;
+#define CHECK_ADDRESS(addr) if (((unsigned) (addr)) > ((unsigned) limit)) goto memoryError;
+#define CHECK_UNDERFLOW(bottom) if ((bottom) < 0) goto memoryError;
+#define CHECK_CODE(label) if (((unsigned) (label)) >= ((unsigned) codeSize)) goto memoryError;
+
+// Return addresses and links live on the KPL stack, where a stray store may
+// have reached them: each is checked before it is followed
+#define FOLLOW_LINKS() \
+  for (addr = b, level = ip->p; level > 0; level --) { \
+    CHECK_ADDRESS(addr + STATIC_LINK_OFFSET); \
+    addr = s[addr + STATIC_LINK_OFFSET]; \
+  }
+
+int run(void) {
+#ifdef VM_SWITCH_DISPATCH
+  Instruction* code = codeBlock->code;
+  Instruction* ip;
+#else
+  static const void* handlers[] = {
+    &&L_OP_LA, &&L_OP_LV, &&L_OP_LC, &&L_OP_LI, &&L_OP_INT, &&L_OP_DCT,
+    &&L_OP_J, &&L_OP_FJ, &&L_OP_HL, &&L_OP_ST, &&L_OP_CALL, &&L_OP_EP,
+    &&L_OP_EF, &&L_OP_RC, &&L_OP_RI, &&L_OP_WRC, &&L_OP_WRI, &&L_OP_WLN,
+    &&L_OP_AD, &&L_OP_SB, &&L_OP_ML, &&L_OP_DV, &&L_OP_NEG, &&L_OP_CV,
+    &&L_OP_EQ, &&L_OP_NE, &&L_OP_GT, &&L_OP_LT, &&L_OP_GE, &&L_OP_LE,
+    &&L_OP_JEQ, &&L_OP_JNE, &&L_OP_JGT, &&L_OP_JLT, &&L_OP_JGE, &&L_OP_JLE,
+    &&L_OP_ENTER, &&L_OP_INCV, &&L_OP_ENTERL, &&L_OP_BP
+  };
+  ThreadedInstruction* code;
+  ThreadedInstruction* ip;
+  int i;
+#endif
+  Memory* s = stack;
+  int limit = stackSize - 1;
+  int codeSize = codeBlock->codeSize;
+  int t = -1;
+  int b = 0;
+  int status = PS_ACTIVE;
+  long long count = 0;
+  int addr;
+  int level;
+  WORD value;
+
+#ifndef VM_SWITCH_DISPATCH
+  if (threadedCode == NULL) {
+    threadedCode = (ThreadedInstruction*) malloc(codeBlock->codeSize * sizeof(ThreadedInstruction));
+    if (threadedCode == NULL)
+      return PS_MEMORY_ERROR;
+    for (i = 0; i < codeBlock->codeSize; i ++) {
+      threadedCode[i].handler = handlers[codeBlock->code[i].op];
+      threadedCode[i].p = codeBlock->code[i].p;
+      threadedCode[i].q = codeBlock->code[i].q;
+    }
+  }
+  code = threadedCode;
+#endif
+
+  ip = code;
+
+#ifdef VM_SWITCH_DISPATCH
+  for (count = 1; ; count ++) {
+    switch (ip->op) {
+#else
+  DISPATCH();
+  {
+#endif
+
+  CASE(OP_LA)
+    CHECK_STACK(t + 1);
+    FOLLOW_LINKS();
+    s[++t] = addr + ip->q;
+    NEXT();
+  CASE(OP_LV)
+    CHECK_STACK(t + 1);
+    FOLLOW_LINKS();
+    CHECK_ADDRESS(addr + ip->q);
+    s[t + 1] = s[addr + ip->q];
+    t ++;
+    NEXT();
+  CASE(OP_LC)
+    CHECK_STACK(t + 1);
+    s[++t] = ip->q;
+    NEXT();
+  CASE(OP_LI)
+    CHECK_UNDERFLOW(t);
+    CHECK_ADDRESS(s[t]);
+    s[t] = s[s[t]];
+    NEXT();
+  CASE(OP_INT)
+    t += ip->q;
+    CHECK_STACK(t);
+    NEXT();
+  CASE(OP_DCT)
+    t -= ip->q;
+    if (t < -1)
+      goto memoryError;
+    NEXT();
+  CASE(OP_J)
+    JUMP(ip->q);
+  CASE(OP_FJ)
+    CHECK_UNDERFLOW(t);
+    if (s[t--] == 0)
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_HL)
+    status = PS_DONE;
+    goto halt;
+  CASE(OP_ST)
+    CHECK_UNDERFLOW(t - 1);
+    CHECK_ADDRESS(s[t - 1]);
+    s[s[t - 1]] = s[t];
+    t -= 2;
+    NEXT();
+  CASE(OP_CALL)
+    CHECK_STACK(t + 4);
+    FOLLOW_LINKS();
+    s[t + 2] = b;
+    s[t + 3] = (ip - code) + 1;
+    s[t + 4] = addr;
+    b = t + 1;
+    JUMP(ip->q);
+  CASE(OP_ENTER)
+    FOLLOW_LINKS();
+    value = b;
+    // The arguments are already pushed: the new frame starts below them
+    b = t - 3 - code[ip->q].p;
+    if (b < 0)
+      goto memoryError;
+    s[b + 1] = value;
+    s[b + 2] = (ip - code) + 1;
+    s[b + 3] = addr;
+    ip = code + ip->q;
+    t = b - 1 + ip->q;
+    CHECK_STACK(t);
+    NEXT();
+  CASE(OP_INCV)
+    CHECK_ADDRESS(b + ip->q);
+    s[b + ip->q] = (WORD) ((unsigned) s[b + ip->q] + (unsigned) ip->p);
+    NEXT();
+  CASE(OP_ENTERL)
+    // The callee never reads its static link, so there is none to find
+    value = b;
+    b = t - 3 - code[ip->q].p;
+    if (b < 0)
+      goto memoryError;
+    s[b + 1] = value;
+    s[b + 2] = (ip - code) + 1;
+    ip = code + ip->q;
+    t = b - 1 + ip->q;
+    CHECK_STACK(t);
+    NEXT();
+  CASE(OP_EP)
+    CHECK_CODE(s[b + 2]);
+    CHECK_ADDRESS(s[b + 1]);
+    t = b - 1;
+    ip = code + s[b + 2];
+    b = s[b + 1];
+    DISPATCH();
+  CASE(OP_EF)
+    CHECK_CODE(s[b + 2]);
+    CHECK_ADDRESS(s[b + 1]);
+    t = b;
+    ip = code + s[b + 2];
+    b = s[b + 1];
+    DISPATCH();
+  CASE(OP_RC)
+    CHECK_STACK(t + 1);
+    fflush(stdout);
+    value = getchar();
+    if (value == EOF)
+      goto ioError;
+    s[++t] = value;
+    NEXT();
+  CASE(OP_RI)
+    CHECK_STACK(t + 1);
+    fflush(stdout);
+    if (scanf("%d", &value) != 1)
+      goto ioError;
+    s[++t] = value;
+    NEXT();
+  CASE(OP_WRC)
+    CHECK_UNDERFLOW(t);
+    putchar(s[t--]);
+    NEXT();
+  CASE(OP_WRI)
+    CHECK_UNDERFLOW(t);
+    printf("%d", s[t--]);
+    NEXT();
+  CASE(OP_WLN)
+    putchar('\n');
+    NEXT();
+  CASE(OP_AD)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (WORD) ((unsigned) s[t] + (unsigned) s[t + 1]);
+    NEXT();
+  CASE(OP_SB)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (WORD) ((unsigned) s[t] - (unsigned) s[t + 1]);
+    NEXT();
+  CASE(OP_ML)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (WORD) ((unsigned) s[t] * (unsigned) s[t + 1]);
+    NEXT();
+  CASE(OP_DV)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    if (s[t + 1] == 0)
+      goto divideByZero;
+    // INT_MIN / -1 traps on most hardware
+    if (s[t + 1] == -1)
+      s[t] = (WORD) (0u - (unsigned) s[t]);
+    else
+      s[t] /= s[t + 1];
+    NEXT();
+  CASE(OP_NEG)
+    CHECK_UNDERFLOW(t);
+    s[t] = (WORD) (0u - (unsigned) s[t]);
+    NEXT();
+  CASE(OP_CV)
+    CHECK_UNDERFLOW(t);
+    CHECK_STACK(t + 1);
+    s[t + 1] = s[t];
+    t ++;
+    NEXT();
+  CASE(OP_EQ)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] == s[t + 1]);
+    NEXT();
+  CASE(OP_NE)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] != s[t + 1]);
+    NEXT();
+  CASE(OP_GT)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] > s[t + 1]);
+    NEXT();
+  CASE(OP_LT)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] < s[t + 1]);
+    NEXT();
+  CASE(OP_GE)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] >= s[t + 1]);
+    NEXT();
+  CASE(OP_LE)
+    CHECK_UNDERFLOW(t - 1);
+    t --;
+    s[t] = (s[t] <= s[t + 1]);
+    NEXT();
+  CASE(OP_JEQ)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] == s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_JNE)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] != s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_JGT)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] > s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_JLT)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] < s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_JGE)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] >= s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_JLE)
+    CHECK_UNDERFLOW(t - 1);
+    t -= 2;
+    if (s[t + 1] <= s[t + 2])
+      JUMP(ip->q);
+    NEXT();
+  CASE(OP_BP)
+    NEXT();
+
+#ifdef VM_SWITCH_DISPATCH
+    default:
+      status = PS_INVALID_INSTRUCTION;
+      goto halt;
+    }
+  }
+#else
+  }
+#endif
+
+ stackOverflow:
+  status = PS_STACK_OVERFLOW;
+  goto halt;
+ memoryError:
+  status = PS_MEMORY_ERROR;
+  goto halt;
+ divideByZero:
+  status = PS_DIVIDE_BY_ZERO;
+  goto halt;
+ ioError:
+  status = PS_IO_ERROR;
+ halt:
+  fflush(stdout);
+  instructionCount = count;
+  return status;
+}
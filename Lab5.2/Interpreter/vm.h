@@ -0,0 +1,45 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __VM_H__
+#define __VM_H__
+
+#include <stdio.h>
+#include "instructions.h"
+
+// Dispatch strategy, selected at build time:
+//   gcc -o kplrun *.c                     computed-goto direct threading (GCC/Clang)
+//   gcc -DVM_SWITCH_DISPATCH -o kplrun *.c  portable switch dispatch
+#if !defined(VM_SWITCH_DISPATCH) && !defined(__GNUC__)
+#define VM_SWITCH_DISPATCH
+#endif
+
+#define PS_INACTIVE -1
+#define PS_ACTIVE 0
+#define PS_DONE 1
+#define PS_DIVIDE_BY_ZERO 2
+#define PS_STACK_OVERFLOW 3
+#define PS_MEMORY_ERROR 4
+#define PS_IO_ERROR 5
+#define PS_INVALID_INSTRUCTION 6
+
+#define DEFAULT_STACK_SIZE 1048576
+
+#define STATIC_LINK_OFFSET 3
+
+typedef int Memory;
+
+int initVM(int stackSize);
+void cleanVM(void);
+
+int loadExecutable(FILE* f);
+CodeBlock* getCodeBlock(void);
+
+int run(void);
+long long getInstructionCount(void);
+const char* getDispatchName(void);
+
+#endif